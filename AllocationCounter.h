@@ -0,0 +1,113 @@
+#pragma once
+
+// C / C++
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// OpenCV
+#include <opencv2/core.hpp>
+
+/* Heap allocation counter to check that tracking runs without allocations once it is warmed up
+* Counts operator new and cv::Mat buffers between start() and stop(). The replaced global operators are
+* compiled into the one translation unit that defines ALLOCATION_COUNTER_HOOK before including this header
+* (ARKanjiReplay), everywhere else counting costs nothing and start() only sees cv::Mat buffers.
+* Code we don't control (Tesseract) runs inside an Ignore scope.
+*/
+namespace AllocationCounter {
+    inline std::atomic<long long>& counter() {
+        static std::atomic<long long> count(0);
+        return count;
+    }
+
+    inline std::atomic<bool>& enabled() {
+        static std::atomic<bool> on(false);
+        return on;
+    }
+
+    inline int& ignoreDepth() {
+        static thread_local int depth = 0;
+        return depth;
+    }
+
+    inline void count() {
+        if (enabled().load(std::memory_order_relaxed) && ignoreDepth() == 0) {
+            counter().fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Allocations in this scope are not counted
+    struct Ignore {
+        Ignore() { ignoreDepth()++; }
+        ~Ignore() { ignoreDepth()--; }
+    };
+
+    // Passes everything to OpenCV's allocator, new buffers are counted
+    class CountingMatAllocator : public cv::MatAllocator {
+        public:
+            CountingMatAllocator(const cv::MatAllocator* para_base) : base(para_base) {}
+
+            cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                cv::AccessFlag flags, cv::UMatUsageFlags usageFlags) const override {
+                if (!data) {
+                    count();
+                }
+                return base->allocate(dims, sizes, type, data, step, flags, usageFlags);
+            }
+
+            bool allocate(cv::UMatData* data, cv::AccessFlag accessFlags, cv::UMatUsageFlags usageFlags) const override {
+                return base->allocate(data, accessFlags, usageFlags);
+            }
+
+            void deallocate(cv::UMatData* data) const override {
+                base->deallocate(data);
+            }
+
+        private:
+            const cv::MatAllocator* base;
+    };
+
+    // Reset the count and start counting on all threads
+    inline void start() {
+        static CountingMatAllocator matAllocator(cv::Mat::getStdAllocator());
+        cv::Mat::setDefaultAllocator(&matAllocator);
+        counter() = 0;
+        enabled() = true;
+    }
+
+    // Allocations since start()
+    inline long long stop() {
+        enabled() = false;
+        return counter().load();
+    }
+}
+
+#ifdef ALLOCATION_COUNTER_HOOK
+void* operator new(std::size_t size) {
+    AllocationCounter::count();
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept {
+    std::free(memory);
+}
+#endif
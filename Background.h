@@ -0,0 +1,129 @@
+#pragma once
+
+// OpenGL
+#include <GL/glew.h>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// Camera frame drawn as a fullscreen textured quad
+// The texture is allocated once and only its content is replaced per frame
+// NV12 frames are uploaded as a Y and a UV texture and converted to RGB by the shader (background_yuv.frag)
+class Background {
+    public:
+        Background(GLuint para_program, int para_width, int para_height, bool para_yuv = false) {
+            program = para_program;
+            width = para_width;
+            height = para_height;
+            yuv = para_yuv;
+
+            if (yuv) {
+                texture = createTexture(GL_R8, width, height, GL_RED);
+                uvTexture = createTexture(GL_RG8, width / 2, height / 2, GL_RG);
+            }
+            else {
+                texture = createTexture(GL_RGB8, width, height, GL_BGR);
+            }
+
+            // x, y in NDC, u, v => OpenCV rows go top down, so v is flipped
+            GLfloat quad[] = {
+                -1.f, -1.f, 0.f, 1.f,
+                 1.f, -1.f, 1.f, 1.f,
+                -1.f,  1.f, 0.f, 0.f,
+                 1.f,  1.f, 1.f, 0.f
+            };
+            glGenVertexArrays(1, &vao);
+            glBindVertexArray(vao);
+            glGenBuffers(1, &vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, vbo);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+            glEnableVertexAttribArray(0);   // In shader (layout = 0) represents vertex pos
+            glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)0);
+            glEnableVertexAttribArray(1);   // In shader (layout = 1) represents texture coords
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), (GLvoid*)(2 * sizeof(GLfloat)));
+            glBindVertexArray(0);
+
+            glUseProgram(program);
+            if (yuv) {
+                glUniform1i(glGetUniformLocation(program, "yPlane"), 0);
+                glUniform1i(glGetUniformLocation(program, "uvPlane"), 1);
+            }
+            else {
+                glUniform1i(glGetUniformLocation(program, "frame"), 0);
+            }
+        }
+
+        ~Background() {
+            release();
+        }
+
+        // Delete texture and quad, must be called while the GL context is still alive
+        void release() {
+            if (texture) {
+                glDeleteTextures(1, &texture);
+                if (uvTexture) {
+                    glDeleteTextures(1, &uvTexture);
+                }
+                glDeleteBuffers(1, &vbo);
+                glDeleteVertexArrays(1, &vao);
+                texture = uvTexture = vbo = vao = 0;
+            }
+        }
+
+        Background(const Background&) = delete;
+        Background& operator=(const Background&) = delete;
+
+        // Upload a BGR (or NV12 when constructed for YUV) frame of the background size and draw it behind everything
+        void draw(const cv::Mat& frame) {
+            glDisable(GL_DEPTH_TEST);
+            glDepthMask(GL_FALSE);
+
+            if (yuv) {
+                // Rows of the planes are tightly packed, initGL's unpack alignment of 1 takes any even width
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RED, GL_UNSIGNED_BYTE, frame.data);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D, uvTexture);
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width / 2, height / 2, GL_RG, GL_UNSIGNED_BYTE, frame.ptr(height));
+                glActiveTexture(GL_TEXTURE0);
+            }
+            else {
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, (GLint)(frame.step / frame.elemSize()));
+                glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, frame.data);
+                glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+            }
+
+            glUseProgram(program);
+            glBindVertexArray(vao);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            glBindVertexArray(0);
+
+            glDepthMask(GL_TRUE);
+            glEnable(GL_DEPTH_TEST);
+        }
+
+    private:
+        GLuint program;
+        GLuint texture = 0;
+        GLuint uvTexture = 0;
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        int width;
+        int height;
+        bool yuv;
+
+        static GLuint createTexture(GLint internalFormat, int textureWidth, int textureHeight, GLenum dataFormat) {
+            GLuint id;
+            glGenTextures(1, &id);
+            glBindTexture(GL_TEXTURE_2D, id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, textureWidth, textureHeight, 0, dataFormat, GL_UNSIGNED_BYTE, NULL);
+            return id;
+        }
+};
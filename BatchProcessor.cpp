@@ -0,0 +1,220 @@
+#include "BatchProcessor.h"
+
+// C / C++
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <chrono>
+#include <exception>
+#include <memory>
+
+Json::Value detectionsToJson(int frameIndex, Tracker& tracker, Lexicon& lexicon) {
+	Json::Value line;
+	line["frame"] = frameIndex;
+	line["markers"] = Json::Value(Json::arrayValue);
+	line["tangos"] = Json::Value(Json::arrayValue);
+
+	std::map<int, cv::Mat> poses = tracker.getDetectedMarkerPose();
+	for (auto const& corners : tracker.getDetectedMarkerCorners()) {
+		Json::Value marker;
+		marker["id"] = corners.first;
+		marker["kanji"] = lexicon.getKanjiById(corners.first);
+		for (const cv::Point2f& corner : corners.second) {
+			Json::Value point(Json::arrayValue);
+			point.append(corner.x);
+			point.append(corner.y);
+			marker["corners"].append(point);
+		}
+		const float* pose = (const float*)poses[corners.first].data;
+		for (int i = 0; i < 16; i++) {
+			marker["pose"].append(pose[i]);
+		}
+		line["markers"].append(marker);
+	}
+	for (const MonjiPair& pair : lexicon.pairMonjis(tracker.getDetectedMarkerCenter())) {
+		if (pair.tangoId == -1) {
+			continue;
+		}
+		Json::Value tango;
+		tango["id"] = pair.tangoId;
+		tango["tango"] = lexicon.getTangoById(pair.tangoId);
+		tango["left"] = pair.left;
+		tango["right"] = pair.right;
+		cv::Mat anchor = interpolatePose(poses[pair.left], poses[pair.right], 0.5f);
+		for (int i = 0; i < 16; i++) {
+			tango["pose"].append(anchor.at<float>(i / 4, i % 4));
+		}
+		line["tangos"].append(tango);
+	}
+	return line;
+}
+
+std::string toJsonLine(const Json::Value& value) {
+	Json::StreamWriterBuilder builder;
+	builder["indentation"] = "";
+	builder["emitUTF8"] = true;
+	return Json::writeString(builder, value);
+}
+
+BatchProcessor::BatchProcessor(Json::Value para_meta, BatchOptions para_options) {
+	meta = para_meta;
+	options = para_options;
+	if (options.threads <= 0) {
+		options.threads = std::max(1, (int)std::thread::hardware_concurrency());
+	}
+}
+
+namespace {
+	// Decoded frame waiting for a worker, sequence is the position in the output
+	struct BatchFrame {
+		long long sequence;
+		int input;
+		int index;
+		cv::Mat image;
+	};
+
+	// Ends and deletes a worker's Tesseract, also when the worker throws
+	struct TesseractRelease {
+		void operator()(tesseract::TessBaseAPI* api) const {
+			api->End();
+			delete api;
+		}
+	};
+}
+
+BatchStats BatchProcessor::run(const std::vector<std::string>& inputs, std::ostream& out) {
+	std::mutex mutex;
+	std::condition_variable changed;
+	std::deque<BatchFrame> queue;
+	std::map<long long, std::string> finished;	// Lines waiting for an earlier frame
+	long long decodedFrames = 0;
+	long long written = 0;
+	bool decoded = false;
+	double busySeconds = 0;
+	std::exception_ptr failure;
+
+	auto start = std::chrono::steady_clock::now();
+
+	auto work = [&]() {
+		try {
+			// Own copies, neither Tesseract nor Json::Value lookups may be shared between threads
+			Json::Value ownMeta;
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				ownMeta = meta;
+			}
+			Lexicon words(ownMeta);
+			std::unique_ptr<tesseract::TessBaseAPI, TesseractRelease> api(initTesseract(words.getWhitelist()));
+			Tracker tracker(api.get(), ownMeta["monji"]);
+			tracker.setDebugWindows(false);
+			tracker.setTablePlane(options.tablePlane);
+			tracker.setIntrinsics(options.intrinsics);
+			tracker.setPyramidLevels(options.pyramidLevels);
+			tracker.setBatchedOcr(options.batchedOcr);
+			double busy = 0;
+
+			while (true) {
+				BatchFrame frame;
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					changed.wait(lock, [&]() { return !queue.empty() || decoded || failure; });
+					if (failure || queue.empty()) {
+						break;
+					}
+					frame = std::move(queue.front());
+					queue.pop_front();
+				}
+
+				auto begin = std::chrono::steady_clock::now();
+				tracker.track(options.yuv ? FrameSource::luminance(frame.image) : frame.image, options.threshold);
+				Json::Value line = detectionsToJson(frame.index, tracker, words);
+				line["input"] = inputs[frame.input];
+				tracker.cleanDetectedMarkers();
+				std::string text = toJsonLine(line);
+				busy += std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+				// Write every line whose predecessors are done
+				std::lock_guard<std::mutex> lock(mutex);
+				finished[frame.sequence] = text;
+				while (!finished.empty() && finished.begin()->first == written) {
+					out << finished.begin()->second << '\n';
+					finished.erase(finished.begin());
+					written++;
+				}
+				changed.notify_all();
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+			busySeconds += busy;
+		}
+		catch (...) {
+			std::lock_guard<std::mutex> lock(mutex);
+			if (!failure) {
+				failure = std::current_exception();
+			}
+			changed.notify_all();
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < options.threads; i++) {
+		workers.emplace_back(work);
+	}
+
+	// Decode on this thread, at most BATCH_FRAMES_IN_FLIGHT frames ahead of the output
+	try {
+		bool stopped = false;
+		for (int input = 0; input < (int)inputs.size() && !stopped; input++) {
+			FrameSource source(inputs[input], options.intrinsics.width, options.intrinsics.height,
+				options.yuv ? FRAME_NV12 : FRAME_BGR, options.yuvLayout);
+			for (int index = 0; ; index++) {
+				{
+					std::unique_lock<std::mutex> lock(mutex);
+					changed.wait(lock, [&]() { return decodedFrames - written < BATCH_FRAMES_IN_FLIGHT || failure; });
+					if (failure) {
+						stopped = true;
+						break;
+					}
+				}
+				// A new Mat per frame, the queued ones are still in use
+				cv::Mat image;
+				if (!source.read(image)) {
+					break;
+				}
+				std::lock_guard<std::mutex> lock(mutex);
+				queue.push_back({ decodedFrames++, input, index, image });
+				changed.notify_all();
+			}
+		}
+	}
+	catch (...) {
+		std::lock_guard<std::mutex> lock(mutex);
+		if (!failure) {
+			failure = std::current_exception();
+		}
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded = true;
+	}
+	changed.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+	out.flush();
+	if (failure) {
+		std::rethrow_exception(failure);
+	}
+
+	BatchStats stats;
+	stats.frames = written;
+	stats.threads = options.threads;
+	stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	stats.busySeconds = busySeconds;
+	stats.fps = stats.seconds > 0 ? stats.frames / stats.seconds : 0;
+	stats.fpsPerCore = busySeconds > 0 ? stats.frames / busySeconds : 0;
+	return stats;
+}
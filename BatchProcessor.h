@@ -0,0 +1,65 @@
+#pragma once
+
+// C / C++
+#include <string>
+#include <vector>
+#include <ostream>
+
+// JSON
+#include <json/json.h>
+
+#include "Tracker.h"
+#include "Lexicon.h"
+#include "FrameSource.h"
+
+// Frames decoded ahead of the slowest worker, bounds the memory of a run
+#define BATCH_FRAMES_IN_FLIGHT 64
+
+/* detectionsToJson
+* Detections of the last tracked frame: recognized monjis with corners and pose, tangos of correctly ordered pairs
+* { "frame": 0, "markers": [ { "id", "kanji", "corners": [[x, y] x4], "pose": [16 floats, row major] } ],
+*   "tangos": [ { "id", "tango", "left", "right", "pose": [16 floats, anchor between both monjis] } ] }
+*/
+Json::Value detectionsToJson(int frameIndex, Tracker& tracker, Lexicon& lexicon);
+
+// One JSON object per line, UTF-8 kanjis unescaped
+std::string toJsonLine(const Json::Value& value);
+
+struct BatchOptions {
+    int threads = 0;            // 0 uses all cores
+    int threshold = 100;        // B/W-Threshold of the tracker
+    bool tablePlane = false;    // See Tracker::setTablePlane
+    int pyramidLevels = 0;      // See Tracker::setPyramidLevels
+    bool batchedOcr = false;    // See Tracker::setBatchedOcr
+    bool yuv = false;           // Raw YUV inputs (see FrameSource), only the Y plane is tracked
+    YuvLayout yuvLayout = YUV_BY_EXTENSION;
+    CameraIntrinsics intrinsics;    // Inputs are resized to its frame size
+};
+
+struct BatchStats {
+    long long frames = 0;
+    int threads = 0;
+    double seconds = 0;         // Wall time of the whole run
+    double busySeconds = 0;     // Tracking time summed over all workers
+    double fps = 0;
+    double fpsPerCore = 0;      // Frames per busy second of one worker
+};
+
+/* Offline detection without OpenGL
+* Decodes the inputs on one thread and tracks the frames on a pool of workers, each with its own Tracker and Tesseract.
+* Lines are written in input order: every frame of the first input, then the second ...
+*/
+class BatchProcessor {
+    public:
+        BatchProcessor(Json::Value para_meta, BatchOptions para_options);
+
+        /* run
+        * @param inputs : video files, image patterns, image directories or camera indices (see FrameSource)
+        * @param out : one JSON line per frame, detectionsToJson plus the "input" path
+        */
+        BatchStats run(const std::vector<std::string>& inputs, std::ostream& out);
+
+    private:
+        Json::Value meta;
+        BatchOptions options;
+};
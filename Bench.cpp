@@ -0,0 +1,307 @@
+#include "Util.h"
+#include "Tracker.h"
+#include "MetaManager.h"
+#if ARKANJI_HEADLESS
+#include "Offscreen.h"
+#endif
+
+// C / C++
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+
+// Every kernel is run in BENCH_REPETITIONS batches, the median batch is reported
+#define BENCH_REPETITIONS 15
+#define BENCH_SEED 42
+
+/* Microbenchmark
+* Times the tracker and pose kernels one by one on a fixed synthetic frame, no camera or window is needed
+* (Model::load gets an offscreen or hidden GL context).
+*
+* ARKanjiBench [--report out.json]
+*/
+
+// Private kernels of the Tracker
+class TrackerBench {
+    public:
+        TrackerBench(Tracker& para_tracker) : tracker(para_tracker) {}
+
+        int subpixSampleSafe(const cv::Mat& gray, const cv::Point2f& p) {
+            return tracker.subpixSampleSafe(gray, p);
+        }
+
+        cv::Mat calculateStripe(double dx, double dy, MyStrip& strip) {
+            return tracker.calculate_Stripe(dx, dy, strip);
+        }
+
+        bool refineEdgePoint(const cv::Mat& gray, cv::Point p, const MyStrip& strip, cv::Mat& stripe, cv::Point2f& edgePoint) {
+            return tracker.refineEdgePoint(gray, p, strip, stripe, edgePoint, NULL);
+        }
+
+        Pix* mat8ToPix(cv::Mat* mat8) {
+            return tracker.mat8ToPix(mat8);
+        }
+
+    private:
+        Tracker& tracker;
+};
+
+// Keeps results alive so the compiler can't drop the timed work
+volatile double benchSink = 0;
+
+/* bench
+* @param name : printed and used as report key
+* @param calls : calls per batch
+* @param fn : one call of the kernel
+*/
+void bench(Json::Value& report, std::string name, int calls, std::function<double()> fn) {
+    std::vector<double> nsPerCall;
+    for (int r = 0; r < BENCH_REPETITIONS; r++) {
+        double sum = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < calls; i++) {
+            sum += fn();
+        }
+        auto end = std::chrono::steady_clock::now();
+        benchSink = benchSink + sum;
+        nsPerCall.push_back(std::chrono::duration<double, std::nano>(end - start).count() / calls);
+    }
+    std::sort(nsPerCall.begin(), nsPerCall.end());
+    double median = nsPerCall[nsPerCall.size() / 2];
+
+    std::cout << "[Bench] " << std::left << std::setw(32) << name << std::right << std::fixed << std::setprecision(1)
+        << std::setw(14) << median << " ns/call  (min " << nsPerCall.front() << ")" << std::endl;
+    report[name]["medianNs"] = median;
+    report[name]["minNs"] = nsPerCall.front();
+}
+
+// Marker image warped into a white 640x480 frame at fixed corners, like a marker held at an angle
+cv::Mat makeFrame(const std::vector<cv::Point2f>& corners) {
+    cv::Mat marker = cv::imread("../etc/flower.png", cv::IMREAD_GRAYSCALE);
+    if (marker.empty()) {
+        // Fallback: black border with a white inner square
+        marker = cv::Mat(200, 200, CV_8UC1, cv::Scalar(0));
+        cv::rectangle(marker, cv::Rect(40, 40, 120, 120), cv::Scalar(255), -1);
+    }
+    cv::Point2f source[4] = {
+        cv::Point2f(0, 0), cv::Point2f((float)marker.cols, 0),
+        cv::Point2f((float)marker.cols, (float)marker.rows), cv::Point2f(0, (float)marker.rows)
+    };
+    cv::Mat frame(WINDOW_HEIGHT, WINDOW_WIDTH, CV_8UC1, cv::Scalar(255));
+    cv::warpPerspective(marker, frame, cv::getPerspectiveTransform(source, corners.data()), frame.size(),
+        cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+    return frame;
+}
+
+// GL context for Model::load, returns false when none can be created
+bool initBenchContext() {
+#if ARKANJI_HEADLESS
+    static std::unique_ptr<OffscreenContext> offscreen;
+    try {
+        offscreen.reset(new OffscreenContext(true));
+    }
+    catch (const std::exception& e) {
+        std::cout << "[Bench] " << e.what() << std::endl;
+        return false;
+    }
+    glewExperimental = GL_TRUE;
+    return glewContextInit() == GLEW_OK;
+#else
+    if (!glfwInit()) {
+        return false;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "ARKanjiBench", NULL, NULL);
+    if (!window) {
+        return false;
+    }
+    glfwMakeContextCurrent(window);
+    glewExperimental = GL_TRUE;
+    return glewInit() == GLEW_OK;
+#endif
+}
+
+int main(int argc, char** argv)
+{
+    std::string reportPath;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--report" && i + 1 < argc) reportPath = argv[++i];
+        else throw std::invalid_argument("Usage: ARKanjiBench [--report out.json]");
+    }
+
+    std::ifstream metaJson(META_JSON_PATH, std::ifstream::binary);
+    Json::Value meta;
+    metaJson >> meta;
+    MetaManager metaManager = MetaManager(meta);
+
+    // Fixed inputs, the same on every run
+    std::vector<cv::Point2f> corners = {
+        cv::Point2f(182.3f, 121.7f), cv::Point2f(431.6f, 143.2f), cv::Point2f(452.1f, 371.4f), cv::Point2f(168.8f, 352.9f)
+    };
+    cv::Mat gray = makeFrame(corners);
+    cv::Mat binary;
+    cv::threshold(gray, binary, 100, 255, cv::THRESH_BINARY);
+
+    cv::RNG rng(BENCH_SEED);
+    std::vector<cv::Point2f> samples(4096);
+    for (cv::Point2f& sample : samples) {
+        sample = cv::Point2f(rng.uniform(0.f, (float)WINDOW_WIDTH), rng.uniform(0.f, (float)WINDOW_HEIGHT));
+    }
+
+    Tracker tracker(NULL, meta["monji"]);
+    TrackerBench kernels(tracker);
+    Json::Value report;
+
+    // Preprocessing of a whole frame: three passes and two allocations against the fused kernel
+    cv::Mat bgr, preGray, preBinary;
+    cv::cvtColor(gray, bgr, cv::COLOR_GRAY2BGR);
+    bench(report, "clone+cvtColor+threshold", 200, [&]() {
+        cv::Mat copy = bgr.clone();
+        cv::Mat converted;
+        cv::cvtColor(copy, converted, cv::COLOR_BGR2GRAY);
+        cv::threshold(converted, converted, 100, 255, cv::THRESH_BINARY);
+        return (double)converted.data[0];
+    });
+    bench(report, "grayAndThreshold", 200, [&]() {
+        grayAndThreshold(bgr, &preGray, preBinary, 100);
+        return (double)preBinary.data[0];
+    });
+    // The tracker's pass without the pyramid, nothing reads the gray image
+    bench(report, "grayAndThreshold binary only", 200, [&]() {
+        grayAndThreshold(bgr, NULL, preBinary, 100);
+        return (double)preBinary.data[0];
+    });
+
+    // Candidate search on the thresholded frame
+    bench(report, "findContours+approxPolyDP", 200, [&]() {
+        cv::Mat scratch = binary.clone();
+        contour_vector_t contours;
+        cv::findContours(scratch, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+        double quads = 0;
+        for (const contour_t& contour : contours) {
+            contour_t approx;
+            cv::approxPolyDP(contour, approx, cv::arcLength(contour, true) * 0.02, true);
+            quads += approx.size() == 4;
+        }
+        return quads;
+    });
+    QuadDetector quadDetector;
+    bench(report, "QuadDetector", 200, [&]() {
+        return (double)quadDetector.detect(binary, MIN_MARKER_SIZE).size();
+    });
+
+    size_t next = 0;
+    bench(report, "subpixSampleSafe", 100000, [&]() {
+        next = (next + 1) & (samples.size() - 1);
+        return (double)kernels.subpixSampleSafe(gray, samples[next]);
+    });
+
+    // All 6 edge points of all 4 edges, like track does for one quad
+    bench(report, "calculate_Stripe+sobel/parabola", 200, [&]() {
+        double sum = 0;
+        for (int i = 0; i < 4; i++) {
+            double dx = (corners[(i + 1) % 4].x - corners[i].x) / 7.0;
+            double dy = (corners[(i + 1) % 4].y - corners[i].y) / 7.0;
+            MyStrip strip;
+            cv::Mat stripe = kernels.calculateStripe(dx, dy, strip);
+            for (int j = 1; j < 7; j++) {
+                cv::Point p((int)(corners[i].x + j * dx), (int)(corners[i].y + j * dy));
+                cv::Point2f edge;
+                if (kernels.refineEdgePoint(binary, p, strip, stripe, edge)) {
+                    sum += edge.x;
+                }
+            }
+        }
+        return sum;
+    });
+
+    cv::Point2f targetCorners[4] = {
+        cv::Point2f(-0.5f, -0.5f), cv::Point2f(99.5f, -0.5f), cv::Point2f(99.5f, 99.5f), cv::Point2f(-0.5f, 99.5f)
+    };
+    cv::Mat imageMarker(cv::Size(100, 100), CV_8UC1);
+    bench(report, "getPerspectiveTransform+warp", 200, [&]() {
+        cv::Mat homography = cv::getPerspectiveTransform(corners.data(), targetCorners);
+        cv::warpPerspective(binary, imageMarker, homography, cv::Size(100, 100));
+        return (double)imageMarker.data[5050];
+    });
+
+    bench(report, "mat8ToPix", 200, [&]() {
+        Pix* pix = kernels.mat8ToPix(&imageMarker);
+        double width = pixGetWidth(pix);
+        pixDestroy(&pix);
+        return width;
+    });
+
+    // Camera coordinates like in track
+    cv::Point2f centered[4];
+    for (int i = 0; i < 4; i++) {
+        centered[i] = cv::Point2f(corners[i].x - WINDOW_WIDTH / 2, -corners[i].y + WINDOW_HEIGHT / 2);
+    }
+    bench(report, "estimateSquarePose", 10000, [&]() {
+        float pose[16];
+        estimateSquarePose(pose, centered, 0.041);
+        return (double)pose[11];
+    });
+
+    // Tango anchor between two monji poses, the second marker sits 250 px to the right
+    float poseMatrix[16];
+    estimateSquarePose(poseMatrix, centered, 0.041);
+    cv::Mat leftPose = cv::Mat(4, 4, CV_32F, poseMatrix).clone();
+    for (int i = 0; i < 4; i++) {
+        centered[i].x += 250;
+    }
+    estimateSquarePose(poseMatrix, centered, 0.041);
+    cv::Mat rightPose = cv::Mat(4, 4, CV_32F, poseMatrix).clone();
+    bench(report, "interpolatePose", 10000, [&]() {
+        cv::Mat pose = interpolatePose(leftPose, rightPose, 0.5f);
+        return (double)pose.at<float>(2, 3);
+    });
+
+    // Four markers side by side on one table, compare with 4x estimateSquarePose
+    std::vector<cv::Point2f> table;
+    for (int m = 0; m < 4; m++) {
+        for (int i = 0; i < 4; i++) {
+            table.push_back(cv::Point2f(centered[i].x - 400 + 120 * m, centered[i].y));
+        }
+    }
+    std::vector<float> tablePoses(16 * 4);
+    bench(report, "estimateTablePoses (4 markers)", 10000, [&]() {
+        estimateTablePoses(tablePoses.data(), table.data(), 4, 0.041f);
+        return (double)tablePoses[11];
+    });
+
+    std::vector<int> monjiIds = metaManager.getMonjiIds();
+    bench(report, "MetaManager::getTangoId", 1000, [&]() {
+        double found = 0;
+        for (int a : monjiIds) {
+            for (int b : monjiIds) {
+                found += metaManager.getTangoId(a, b);
+            }
+        }
+        return found;
+    });
+
+    if (initBenchContext()) {
+        std::string modelPath = "../" + meta["monji"][0]["model"].asString();
+        bench(report, "Model::load", 3, [&]() {
+            Model model;
+            model.load(modelPath);
+            return (double)model.byteSize();
+        });
+    }
+    else {
+        std::cout << "[Bench] No GL context, Model::load skipped" << std::endl;
+    }
+
+    if (!reportPath.empty()) {
+        std::ofstream out(reportPath);
+        out << report;
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+// C / C++
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// OpenCV
+#include <opencv2/core.hpp>
+#include <opencv2/calib3d.hpp>
+
+// Without a calibration file: the laptop camera the pose estimation was tuned for
+#define DEFAULT_FRAME_WIDTH 640
+#define DEFAULT_FRAME_HEIGHT 480
+#define DEFAULT_FOCAL_LENGTH 634.0
+
+// Pinhole camera in pixels of the frames the tracker gets, principal point measured from the top left
+struct CameraIntrinsics {
+    int width = DEFAULT_FRAME_WIDTH;
+    int height = DEFAULT_FRAME_HEIGHT;
+    double fx = DEFAULT_FOCAL_LENGTH;
+    double fy = DEFAULT_FOCAL_LENGTH;
+    double cx = DEFAULT_FRAME_WIDTH / 2.0;
+    double cy = DEFAULT_FRAME_HEIGHT / 2.0;
+    // OpenCV order k1, k2, p1, p2[, k3 ...], empty for a pinhole camera; unitless, so unchanged by scaledTo
+    std::vector<double> distortion;
+
+    // The same camera delivering frames of another size
+    CameraIntrinsics scaledTo(int para_width, int para_height) const {
+        CameraIntrinsics scaled = *this;
+        double sx = (double)para_width / width, sy = (double)para_height / height;
+        scaled.width = para_width;
+        scaled.height = para_height;
+        scaled.fx = fx * sx;
+        scaled.fy = fy * sy;
+        scaled.cx = cx * sx;
+        scaled.cy = cy * sy;
+        return scaled;
+    }
+
+    // Pixel sizes tuned at 640 px width are multiplied with this
+    double sizeScale() const {
+        return (double)width / DEFAULT_FRAME_WIDTH;
+    }
+
+    cv::Matx33d cameraMatrix() const {
+        return cv::Matx33d(fx, 0, cx, 0, fy, cy, 0, 0, 1);
+    }
+
+    /* undistortPixels
+    * Moves distorted pixel positions in place to where the pinhole camera would see them.
+    * Only the given points are corrected (iteratively), the frame itself is never remapped.
+    */
+    void undistortPixels(cv::Point2f* points, int count) const {
+        if (distortion.empty() || count <= 0) {
+            return;
+        }
+        // In place through a header, undistortPoints reads every point before it writes it, nothing is allocated
+        cv::Mat pixels(count, 1, CV_32FC2, points);
+        cv::undistortPoints(pixels, pixels, cameraMatrix(), distortion, cv::noArray(), cameraMatrix());
+    }
+};
+
+/* loadCalibration
+* Reads the output of OpenCV's camera calibration (YAML, XML or JSON):
+* image_width, image_height, the 3x3 camera_matrix and optionally distortion_coefficients
+*/
+inline CameraIntrinsics loadCalibration(std::string path) {
+    cv::FileStorage file(path, cv::FileStorage::READ);
+    if (!file.isOpened()) {
+        throw std::invalid_argument("Cannot read calibration " + path);
+    }
+    cv::Mat cameraMatrix;
+    file["camera_matrix"] >> cameraMatrix;
+    if (cameraMatrix.rows != 3 || cameraMatrix.cols != 3) {
+        throw std::invalid_argument("No 3x3 camera_matrix in " + path);
+    }
+    cameraMatrix.convertTo(cameraMatrix, CV_64F);
+
+    CameraIntrinsics intrinsics;
+    file["image_width"] >> intrinsics.width;
+    file["image_height"] >> intrinsics.height;
+    if (intrinsics.width <= 0 || intrinsics.height <= 0) {
+        throw std::invalid_argument("No image_width/image_height in " + path);
+    }
+    intrinsics.fx = cameraMatrix.at<double>(0, 0);
+    intrinsics.fy = cameraMatrix.at<double>(1, 1);
+    intrinsics.cx = cameraMatrix.at<double>(0, 2);
+    intrinsics.cy = cameraMatrix.at<double>(1, 2);
+
+    cv::Mat coefficients;
+    file["distortion_coefficients"] >> coefficients;
+    if (!coefficients.empty()) {
+        int count = (int)coefficients.total();
+        if (count != 4 && count != 5 && count != 8 && count != 12 && count != 14) {
+            throw std::invalid_argument("distortion_coefficients in " + path + " needs 4, 5, 8, 12 or 14 values");
+        }
+        coefficients.convertTo(coefficients, CV_64F);
+        intrinsics.distortion.assign((double*)coefficients.data, (double*)coefficients.data + count);
+    }
+    return intrinsics;
+}
+
+// Same layout as loadCalibration reads
+inline void saveCalibration(std::string path, const CameraIntrinsics& intrinsics) {
+    cv::FileStorage file(path, cv::FileStorage::WRITE);
+    if (!file.isOpened()) {
+        throw std::invalid_argument("Cannot write calibration " + path);
+    }
+    file << "image_width" << intrinsics.width;
+    file << "image_height" << intrinsics.height;
+    file << "camera_matrix" << cv::Mat(intrinsics.cameraMatrix());
+    if (!intrinsics.distortion.empty()) {
+        file << "distortion_coefficients" << cv::Mat(intrinsics.distortion);
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+// OpenGL
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Calibration.h"
+
+// Binding point of the "Camera" uniform block in every program
+#define CAMERA_UBO_BINDING 0
+
+// Projection and view of the frame, kept in application memory
+// Shaders read them from a std140 uniform block, so they are uploaded once per change
+// and never read back from the GL
+class Camera {
+    public:
+        Camera() : projection(1.f), view(1.f) {}
+
+        ~Camera() {
+            release();
+        }
+
+        // Delete the uniform buffer, must be called while the GL context is still alive
+        void release() {
+            if (ubo) {
+                glDeleteBuffers(1, &ubo);
+                ubo = 0;
+            }
+        }
+
+        Camera(const Camera&) = delete;
+        Camera& operator=(const Camera&) = delete;
+
+        // Create the uniform buffer, needs a current GL context
+        void init() {
+            glGenBuffers(1, &ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), NULL, GL_DYNAMIC_DRAW);
+            glBindBufferBase(GL_UNIFORM_BUFFER, CAMERA_UBO_BINDING, ubo);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            dirty = true;
+        }
+
+        // Connect the "Camera" block of a program to the buffer, programs without it are skipped
+        void attach(GLuint program) {
+            GLuint block = glGetUniformBlockIndex(program, "Camera");
+            if (block != GL_INVALID_INDEX) {
+                glUniformBlockBinding(program, block, CAMERA_UBO_BINDING);
+            }
+        }
+
+        // Perspective of the real camera, so models line up with the markers in the background frame
+        // Image rows go down, the principal point is measured from the top
+        void setIntrinsics(const CameraIntrinsics& intrinsics) {
+            float near = 0.01f, far = 100.f;
+            float left = (float)(-intrinsics.cx / intrinsics.fx) * near;
+            float right = (float)((intrinsics.width - intrinsics.cx) / intrinsics.fx) * near;
+            float bottom = (float)(-(intrinsics.height - intrinsics.cy) / intrinsics.fy) * near;
+            float top = (float)(intrinsics.cy / intrinsics.fy) * near;
+            projection = glm::frustum(left, right, bottom, top, near, far);
+            dirty = true;
+        }
+
+        void setView(const glm::mat4& para_view) {
+            view = para_view;
+            dirty = true;
+        }
+
+        // Copy changed matrices into the uniform buffer, called once per frame before drawing
+        void upload() {
+            if (!dirty) {
+                return;
+            }
+            glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+            glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(projection));
+            glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(view));
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+            dirty = false;
+        }
+
+        const glm::mat4& getProjection() {
+            return projection;
+        }
+
+        const glm::mat4& getView() {
+            return view;
+        }
+
+    private:
+        glm::mat4 projection;
+        glm::mat4 view;
+        GLuint ubo = 0;
+        bool dirty = true;
+};
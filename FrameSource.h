@@ -0,0 +1,215 @@
+#pragma once
+
+// C / C++
+#include <string>
+#include <vector>
+#include <cctype>
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+// Pixel layout of the delivered frames
+enum FrameFormat {
+    FRAME_BGR,  // CV_8UC3
+    FRAME_NV12  // CV_8UC1 with height * 3 / 2 rows: the Y plane, then U/V interleaved at half resolution
+};
+
+// Layout of a raw YUV file, by default the extension tells it (.yuv is I420, .nv12 is NV12)
+enum YuvLayout {
+    YUV_BY_EXTENSION,
+    YUV_I420,
+    YUV_NV12
+};
+
+// Value of the --yuv option of the harnesses: auto, i420 or nv12
+inline YuvLayout parseYuvLayout(const std::string& name) {
+    if (name == "auto") return YUV_BY_EXTENSION;
+    if (name == "i420") return YUV_I420;
+    if (name == "nv12") return YUV_NV12;
+    throw std::invalid_argument("Unknown YUV layout " + name + ", use auto, i420 or nv12");
+}
+
+// Frames from a camera, a video file, an image sequence or a raw YUV file
+// Every frame is delivered in the size the pipeline was set up for
+class FrameSource {
+    public:
+        /* FrameSource
+        * @param input : camera index ("0"), video file, printf pattern ("frames/%04d.png"), directory of images,
+        *                or with FRAME_NV12 a raw .yuv (I420) or .nv12 file of frames in exactly this size
+        * @param para_width, para_height : size of the delivered frames, others are resized
+        * @param para_format : FRAME_NV12 skips the color conversion, only cameras and raw files deliver it
+        * @param layout : with FRAME_NV12, reads any file that is not a camera index as raw frames of this layout
+        */
+        FrameSource(std::string input, int para_width, int para_height, FrameFormat para_format = FRAME_BGR,
+            YuvLayout layout = YUV_BY_EXTENSION) {
+            width = para_width;
+            height = para_height;
+            format = para_format;
+
+            if (format == FRAME_NV12) {
+                if (width % 2 || height % 2) {
+                    throw std::invalid_argument("YUV frames need an even width and height");
+                }
+                size_t dot = input.find_last_of('.');
+                std::string extension = dot == std::string::npos ? "" : input.substr(dot + 1);
+                bool camera = !input.empty() && std::all_of(input.begin(), input.end(), ::isdigit);
+                if (extension == "yuv" || extension == "nv12" || (layout != YUV_BY_EXTENSION && !camera)) {
+                    raw.open(input, std::ifstream::binary);
+                    if (!raw.is_open()) {
+                        throw std::invalid_argument("Cannot open input: " + input);
+                    }
+                    planar = layout == YUV_BY_EXTENSION ? extension == "yuv" : layout == YUV_I420;
+                    return;
+                }
+                if (input.empty() || !std::all_of(input.begin(), input.end(), ::isdigit)) {
+                    throw std::invalid_argument("YUV input needs a camera or a raw .yuv/.nv12 file: " + input);
+                }
+            }
+
+            if (!input.empty() && std::all_of(input.begin(), input.end(), ::isdigit)) {
+                capture.open(std::stoi(input));
+                live = true;
+                if (format == FRAME_NV12) {
+                    // Raw buffers of the driver, the size cannot be fixed by resizing
+                    capture.set(cv::CAP_PROP_FRAME_WIDTH, width);
+                    capture.set(cv::CAP_PROP_FRAME_HEIGHT, height);
+                    capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
+                }
+            }
+            else if (isDirectory(input)) {
+                // All images of the directory in name order
+                std::vector<cv::String> found;
+                for (std::string pattern : { "*.png", "*.jpg", "*.jpeg", "*.bmp" }) {
+                    cv::glob(input + "/" + pattern, found, false);
+                    files.insert(files.end(), found.begin(), found.end());
+                }
+                std::sort(files.begin(), files.end());
+                if (files.empty()) {
+                    throw std::invalid_argument("No images in " + input);
+                }
+                return;
+            }
+            else {
+                // Video files and printf patterns are both handled by VideoCapture
+                capture.open(input);
+            }
+
+            if (!capture.isOpened()) {
+                throw std::invalid_argument("Cannot open input: " + input);
+            }
+        }
+
+        // Next frame, false at the end of a file input or when the camera fails
+        bool read(cv::Mat& frame) {
+            if (format == FRAME_NV12) {
+                return readYuv(frame);
+            }
+            if (!files.empty()) {
+                if (next >= files.size()) {
+                    return false;
+                }
+                frame = cv::imread(files[next++], cv::IMREAD_COLOR);
+                if (frame.empty()) {
+                    throw std::invalid_argument("Cannot read image: " + files[next - 1]);
+                }
+            }
+            else if (!capture.read(frame)) {
+                return false;
+            }
+
+            sourceSize = frame.size();
+            if (frame.cols != width || frame.rows != height) {
+                cv::resize(frame, frame, cv::Size(width, height));
+            }
+            return true;
+        }
+
+        // Size of the last frame before resizing, e.g. to scale ground truth coordinates
+        cv::Size getSourceSize() {
+            return sourceSize;
+        }
+
+        // Camera inputs run until the window is closed
+        bool isLive() {
+            return live;
+        }
+
+        // Y plane of an NV12 frame, no copy
+        static cv::Mat luminance(const cv::Mat& nv12) {
+            return nv12.rowRange(0, nv12.rows * 2 / 3);
+        }
+
+    private:
+        cv::VideoCapture capture;
+        std::vector<std::string> files;
+        size_t next = 0;
+        int width;
+        int height;
+        cv::Size sourceSize;
+        bool live = false;
+        FrameFormat format;
+        std::ifstream raw;
+        bool planar = false;    // I420: U and V planes one after another
+        cv::Mat buffer;         // Raw frame before repacking
+
+        // Raw frame to NV12; the Y plane is used as it is, only the quarter size chroma is repacked
+        bool readYuv(cv::Mat& frame) {
+            frame.create(height * 3 / 2, width, CV_8UC1);
+            cv::Mat uv(height / 2, width / 2, CV_8UC2, frame.ptr(height));
+            size_t lumaBytes = (size_t)width * height;
+            sourceSize = cv::Size(width, height);
+
+            if (raw.is_open()) {
+                if (!planar) {
+                    return (bool)raw.read((char*)frame.data, lumaBytes * 3 / 2);
+                }
+                if (!raw.read((char*)frame.data, lumaBytes)) {
+                    return false;
+                }
+                buffer.create(2, (int)(lumaBytes / 4), CV_8UC1);
+                if (!raw.read((char*)buffer.data, lumaBytes / 2)) {
+                    return false;
+                }
+                cv::Mat planes[2] = { buffer.row(0).reshape(1, height / 2), buffer.row(1).reshape(1, height / 2) };
+                cv::merge(planes, 2, uv);
+                return true;
+            }
+
+            if (!capture.read(buffer)) {
+                return false;
+            }
+            // Drivers hand out the plain buffer, either packed YUYV or NV12
+            size_t bytes = buffer.total() * buffer.elemSize();
+            if (bytes == lumaBytes * 3 / 2) {
+                std::memcpy(frame.data, buffer.data, bytes);
+            }
+            else if (bytes == lumaBytes * 2) {
+                // YUYV as two channels: Y of every pixel, then U and V alternating => UV rows are the odd bytes of even rows
+                cv::Mat yuyv(height, width, CV_8UC2, buffer.data);
+                cv::Mat luma = luminance(frame);
+                cv::extractChannel(yuyv, luma, 0);
+                for (int y = 0; y < height / 2; y++) {
+                    const uchar* src = yuyv.ptr<uchar>(2 * y);
+                    uchar* dst = uv.ptr<uchar>(y);
+                    for (int x = 0; x < width; x++) {
+                        dst[x] = src[2 * x + 1];
+                    }
+                }
+            }
+            else {
+                throw std::invalid_argument("Camera delivers no YUYV/NV12 frames of " + std::to_string(width) + "x" +
+                    std::to_string(height) + ", run without YUV input");
+            }
+            return true;
+        }
+
+        static bool isDirectory(const std::string& path) {
+            struct stat info;
+            return stat(path.c_str(), &info) == 0 && (info.st_mode & S_IFDIR);
+        }
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+// C / C++
+#include <map>
+#include <string>
+#include <vector>
+
+// JSON
+#include <json/json.h>
+
+// OpenCV
+#include <opencv2/core.hpp>
+
+#define META_JSON_PATH "../meta.json"
+
+// Two detected monjis ordered left to right, tangoId is -1 when they form no tango
+struct MonjiPair {
+    int left;
+    int right;
+    int tangoId;
+    cv::Point2f leftCenter;
+    cv::Point2f rightCenter;
+};
+
+// Monjis, tangos and their readings from meta.json, without any rendering state
+// so the recognition side can be used without an OpenGL context
+class Lexicon {
+    public:
+        Lexicon(Json::Value para_json) {
+            json = para_json;
+            monjis = para_json["monji"];
+            tangos = para_json["tango"];
+        }
+
+        int getMonjisSize() {
+            return monjis.size();
+        }
+
+        int getTangosSize() {
+            return tangos.size();
+        }
+
+        std::vector<int> getMonjiIds() {
+            std::vector<int> ids;
+            for (int i = 0; i < monjis.size(); i++) {
+                ids.push_back(monjis[i]["id"].asInt());
+            }
+            return ids;
+        }
+
+        std::vector<int> getTangoIds() {
+            std::vector<int> ids;
+            for (int i = 0; i < tangos.size(); i++) {
+                ids.push_back(tangos[i]["id"].asInt());
+            }
+            return ids;
+        }
+
+        int getIdByKanji(std::string kanji) {
+            for (int i = 0; i < monjis.size(); i++) {
+                if (kanji.find(monjis[i]["kanji"].asString()) != std::string::npos) {
+                    return monjis[i]["id"].asInt();
+                }
+            }
+            return -1;
+        }
+
+        std::string getKanjiById(int id) {
+            for (int i = 0; i < monjis.size(); i++) {
+                if (id == monjis[i]["id"].asInt()) {
+                    return monjis[i]["kanji"].asString();
+                }
+            }
+            return "";
+        }
+
+        std::string getTangoById(int id) {
+            for (int i = 0; i < tangos.size(); i++) {
+                if (id == tangos[i]["id"].asInt()) {
+                    return tangos[i]["kanji"].asString();
+                }
+            }
+            return "";
+        }
+
+        // Find whether two monjis can form a tango, if yes return id of tango
+        int getTangoId(int id1, int id2) {
+            for (int i = 0; i < tangos.size(); i++) {
+                int tangoId = tangos[i]["id"].asInt();
+                if ((tangoId / 10) == id1 && (tangoId % 10) == id2) {
+                    return tangos[i]["id"].asInt();
+                }
+            }
+            return -1;
+        }
+
+        // Check the position relationship between every two detected markers
+        // Are they in right sequence? 
+        // Like 日本 not 本日 (means today, but .. hard to find a model to represent, so exclude here
+        std::vector<MonjiPair> pairMonjis(const std::map<int, cv::Point2f>& centers) {
+            std::vector<MonjiPair> pairs;
+            for (auto a = centers.begin(); a != centers.end(); ++a) {
+                for (auto b = std::next(a); b != centers.end(); ++b) {
+                    auto left = a->second.x < b->second.x ? a : b;
+                    auto right = left == a ? b : a;
+                    pairs.push_back({ left->first, right->first, getTangoId(left->first, right->first), left->second, right->second });
+                }
+            }
+            return pairs;
+        }
+
+        // Return u8 encoded onyomi string
+        std::string getOnyomiById(int id) {
+            for (int i = 0; i < monjis.size(); i++) {
+                if (id == monjis[i]["id"].asInt()) {
+                    return monjis[i]["onyomi"].asString();
+                }
+            }
+            return "";
+        }
+
+        // Return u8 encoded kunyomi string
+        std::string getKunyomiById(int id) {
+            for (int i = 0; i < monjis.size(); i++) {
+                if (id == monjis[i]["id"].asInt()) {
+                    return monjis[i]["kunyomi"].asString();
+                }
+            }
+            return "";
+        }
+
+        // All kanjis Tesseract may recognize
+        std::string getWhitelist() {
+            std::string whitelist = "";
+            for (int i = 0; i < monjis.size(); i++) {
+                whitelist += monjis[i]["kanji"].asString();
+            }
+            return whitelist;
+        }
+
+    protected:
+        Json::Value monjis;
+        Json::Value tangos;
+        Json::Value json;
+};
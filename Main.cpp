@@ -1,91 +1,57 @@
 ﻿#include "Util.h"
 #include "Tracker.h"
 #include "MetaManager.h"
+#include "RenderQueue.h"
+#include "TextMesh.h"
+#include "Background.h"
+#include "FrameSource.h"
+#include "Metrics.h"
+#include "BatchProcessor.h"
+#if ARKANJI_HEADLESS
+#include "Offscreen.h"
+#endif
 
 // tuple => monji1Id, monji2Id, tangoId
 std::vector<std::tuple<int, int, int>> monjiCombinations;
 
-// Rendering camera frame input as background in OpenGL 
-void renderBackground(cv::Mat frame) {
-    // Cam Height * Cam Width * #RGB Channel 3
-    unsigned char bkgnd[WINDOW_HEIGHT * WINDOW_WIDTH * 3];
-    // Copy data from cv::Mat frame
-    memcpy(bkgnd, frame.data, sizeof(bkgnd));
-
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-    glMatrixMode(GL_MODELVIEW);
-    // No position changes
-    glLoadIdentity();
-    glDisable(GL_DEPTH_TEST);
-
-    glMatrixMode(GL_PROJECTION);
-
-    glPushMatrix();
-    glLoadIdentity();
-
-    // In the ortho view all objects stay the same size at every distance
-    glOrtho(0.0, WINDOW_WIDTH, 0.0, WINDOW_HEIGHT, -1, 1);
-    glRasterPos2i(0, WINDOW_HEIGHT - 1);
-    glDrawPixels(WINDOW_WIDTH, WINDOW_HEIGHT, GL_BGR_EXT, GL_UNSIGNED_BYTE, bkgnd);
-
-    glPopMatrix();
-}
-
 // Draw combination lines for monjis 
 // The line will be drawn in OpenCV frame, not directly in OpenGL world
 // The frame with lines will be passed into OpenGL as background, which is more easy to implement
 // Compared with drawing lines in the context of OpenGL
-void drawLines(Tracker tracker, MetaManager metaManager, cv::Mat img) {
-    std::map<int, cv::Point2f> centersMap = tracker.getDetectedMarkerCenter();
+// A BGR colored line on a BGR frame or on both planes of an NV12 frame
+void drawFrameLine(cv::Mat img, cv::Point2f from, cv::Point2f to, cv::Scalar bgr, bool yuv) {
+    if (!yuv) {
+        cv::line(img, from, to, bgr, 2);
+        return;
+    }
+    // Same conversion the camera uses: 2x2 pixels => 4 Y, 1 U, 1 V
+    cv::Mat color(2, 2, CV_8UC3, bgr), i420;
+    cv::cvtColor(color, i420, cv::COLOR_BGR2YUV_I420);
+    int height = img.rows * 2 / 3;
+    cv::Mat uv(height / 2, img.cols / 2, CV_8UC2, img.ptr(height));
+    cv::line(FrameSource::luminance(img), from, to, cv::Scalar(i420.data[0]), 2);
+    cv::line(uv, from * 0.5f, to * 0.5f, cv::Scalar(i420.data[4], i420.data[5]), 1);
+}
 
+void drawLines(Tracker& tracker, MetaManager& metaManager, cv::Mat img, bool yuv) {
     // Need to draw, only when multiple markers are detected
-    if (centersMap.size() >= 2) {
-        std::vector<std::pair<int, cv::Point>> centers;
-        for (auto const& x : centersMap) {
-            centers.push_back(std::make_pair(x.first, x.second));
+    for (const MonjiPair& pair : metaManager.pairMonjis(tracker.getDetectedMarkerCenter())) {
+        // When two monjis are correctly ordered => they have a tangoId
+        if (pair.tangoId != -1) {
+            drawFrameLine(img, pair.leftCenter, pair.rightCenter, cv::Scalar(0, 255, 0), yuv);
+            monjiCombinations.push_back(std::make_tuple(pair.left, pair.right, pair.tangoId));
         }
-
-        // Check the position relationship between two detected markers
-        // Are they in right sequence? 
-        // Like 日本 not 本日 (means today, but .. hard to find a model to represent, so exclude here
-        for (int i = 0; i < centers.size(); i++) {
-            for (int j = i + 1; j < centers.size(); j++) {
-                cv::Point2f point_a = centers[i].second;
-                cv::Point2f point_b = centers[j].second;
-                std::pair<int, cv::Point2f> left;
-                std::pair<int, cv::Point2f> right;
-
-                if (point_a.x < point_b.x) {
-                    left = centers[i];
-                    right = centers[j];
-                }
-                else {
-                    left = centers[j];
-                    right = centers[i];
-                }
-
-                // When two monjis are correctly ordered => get the tangoId
-                int tangoId = metaManager.getTangoId(left.first, right.first);
-                if (tangoId != -1) {
-                    cv::line(img, left.second, right.second, cv::Scalar(0, 255, 0), 2);
-                    monjiCombinations.push_back(std::make_tuple(left.first, right.first, tangoId));
-                }
-                else {
-                    if (DRAW_ALL_LINES) {
-                        cv::line(img, left.second, right.second, cv::Scalar(0, 0, 255), 2);
-                    }
-                }
+        else {
+            if (DRAW_ALL_LINES) {
+                drawFrameLine(img, pair.leftCenter, pair.rightCenter, cv::Scalar(0, 0, 255), yuv);
             }
         }
     }
 }
 
 // Rendering Yomikata and Presentation-Model
-void renderObjs(Tracker tracker, MetaManager metaManager, GLuint program, FTFont* font) {
-    glEnable(GL_DEPTH_TEST);
-    glMatrixMode(GL_MODELVIEW);
-
+// Poses are composed on the CPU, projection and view come from the Camera uniform block
+void renderObjs(Tracker& tracker, MetaManager& metaManager, TextMeshCache& textMeshes, RenderQueue& queue, GLuint program) {
     std::map<int, cv::Mat> markers = tracker.getDetectedMarkerPose();
     
     for (auto const& markerPair : markers) {
@@ -99,76 +65,37 @@ void renderObjs(Tracker tracker, MetaManager metaManager, GLuint program, FTFont
             }
         }
 
-        // Rendering Yomikata 読み方 by using FTGL
-        glUseProgram(0);
-        glLoadMatrixf(resultTransposedMatrix);
-        glRotatef(-90, 1, 0, 0);
-        glRotatef(90, 0, 1, 0);
-        glRotatef(-90, 1, 0, 0);
-        glScalef(0.01, 0.01, 0.01);
-
-        // Set the Color for Font Rendering
-        glColor3f(0, 0.36, 0.08); // しんぺき -> https://irocore.com/shinpeki/
+        // Rendering Yomikata 読み方, the text meshes are built once per monji
+        glm::mat4 label = glm::make_mat4(resultTransposedMatrix);
+        label = glm::rotate(label, glm::radians(-90.f), glm::vec3(1, 0, 0));
+        label = glm::rotate(label, glm::radians(90.f), glm::vec3(0, 1, 0));
+        label = glm::rotate(label, glm::radians(-90.f), glm::vec3(1, 0, 0));
+        label = glm::scale(label, glm::vec3(0.01f));
 
-        // Rendering Onyomi Text
-        glTranslatef(-3, 3.5, 0);
-        std::string onyomi = u8"音読み：";
-        font->Render((onyomi + metaManager.getOnyomiById(markerPair.first)).c_str());
+        // Onyomi Text
+        label = glm::translate(label, glm::vec3(-3, 3.5, 0));
+        queue.submit(textMeshes.getProgram(), textMeshes.get(markerPair.first, LABEL_ONYOMI), label, 1);
 
-        // Rendering Kunyomi Text
-        glTranslatef(0, 1.5, 0);
-        std::string kunyomi = u8"訓読み：";
-        font->Render((kunyomi + metaManager.getKunyomiById(markerPair.first)).c_str());
-
-        // Reset the MV matrix and start rendering the imported model 
-        glLoadIdentity();
-        glUseProgram(program);
+        // Kunyomi Text
+        label = glm::translate(label, glm::vec3(0, 1.5, 0));
+        queue.submit(textMeshes.getProgram(), textMeshes.get(markerPair.first, LABEL_KUNYOMI), label, 1);
 
         if (resultMatrix[0] != -1) {
-            GLfloat projection[16];
-            glGetFloatv(GL_PROJECTION_MATRIX, projection);
-
-            // Get tunning matrix to rescale, rotation ...
-            glm::mat4 tunning = metaManager.getModelTunningMatrix(markerPair.first, glm::make_mat4(resultTransposedMatrix));
-            
-            // Pass the uniform to shader
-            GLuint location = glGetUniformLocation(program, "MVP");
-            glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(glm::make_mat4(projection) * tunning));
-            
-            // Rendering the model
-            metaManager.getModelById(markerPair.first).draw(program);   
+            // Queue the model, it's drawn together with all others sorted by state
+            // Rescale, rotation ... are baked into the model at load
+            queue.submit(program, metaManager.getModelById(markerPair.first), glm::make_mat4(resultTransposedMatrix));
         }
     }
 }
 // Rendering the possible monjis combination => tangos
-void renderCombis(Tracker tracker, MetaManager modelManager, GLuint program, FTFont* font) {
-    glEnable(GL_DEPTH_TEST);
-    glMatrixMode(GL_MODELVIEW);
-
-    // Get the current furstum projection
-    GLfloat projection[16];
-    glGetFloatv(GL_PROJECTION_MATRIX, projection);
-
+void renderCombis(Tracker& tracker, MetaManager& modelManager, TextMeshCache& textMeshes, RenderQueue& queue, GLuint program) {
     for (std::tuple<int, int, int> combiPair : monjiCombinations) {
         int m1Id = std::get<0>(combiPair); // monjiId1
         int m2Id = std::get<1>(combiPair); // monjiId2
 
-        std::vector<cv::Point2f> m1MarkerCorners = tracker.getMarkerCornersById(m1Id); // Corners of monjiMarker1
-        std::vector<cv::Point2f> m2MarkerCorners = tracker.getMarkerCornersById(m2Id); // Corners of monjiMarker2
-
-        cv::Point2f m1Center = tracker.getMarkerCenterById(m1Id); // Center of MonjiMarker1
-        cv::Point2f m2Center = tracker.getMarkerCenterById(m2Id); // Center of MonjiMarker2
-        cv::Point2f offset = (m2Center - m1Center) / 2.0; // The offset, we should set to middle point
-
-        // to m1MarkerCorners[i] + (m2Center - m1Center) / 2.0
-        for (int i = 0; i < 4; i++) {
-            m1MarkerCorners[i] += offset;
-        }
-
-        // Now we have a virtual marker at the middle point of marker1 and marker2
-
-        // Get the pose of that virtual marker
-        float* resultMatrix = (float*)getVirtualPose(m1MarkerCorners).data;
+        // Anchor in the middle of both monjis, derived from their poses instead of solving a virtual marker
+        cv::Mat anchor = interpolatePose(tracker.getMarkerPoseById(m1Id), tracker.getMarkerPoseById(m2Id), 0.5f);
+        float* resultMatrix = (float*)anchor.data;
 
         float resultTransposedMatrix[16];
         for (int x = 0; x < 4; ++x) {
@@ -177,33 +104,59 @@ void renderCombis(Tracker tracker, MetaManager modelManager, GLuint program, FTF
             }
         }
 
-        glUseProgram(0);
-        glLoadMatrixf(resultTransposedMatrix);
-        glRotatef(-90, 1, 0, 0);
-        glRotatef(90, 0, 1, 0);
-        glRotatef(-90, 1, 0, 0);
-        glRotatef(180, 0, 0, 1);
-        glScalef(0.01, 0.01, 0.01);
-
-        // Set the Color for Font Rendering
-        glColor3f(0, 0.35, 0.6); // こんぺき -> https://irocore.com/konpeki/
-
-        // Rendering Tango Text
-        glTranslatef(-1, -5, 0);
-        font->Render((modelManager.getTangoById(std::get<2>(combiPair))).c_str());
-
-        glLoadIdentity();
-
-        glUseProgram(program);
-
-        glm::mat4 tunning = modelManager.getModelTunningMatrix(std::get<2>(combiPair), glm::make_mat4(resultTransposedMatrix));
-        GLuint location = glGetUniformLocation(program, "MVP");
-        glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(glm::make_mat4(projection) * tunning));
+        // Tango Text, built once per tango
+        glm::mat4 label = glm::make_mat4(resultTransposedMatrix);
+        label = glm::rotate(label, glm::radians(-90.f), glm::vec3(1, 0, 0));
+        label = glm::rotate(label, glm::radians(90.f), glm::vec3(0, 1, 0));
+        label = glm::rotate(label, glm::radians(-90.f), glm::vec3(1, 0, 0));
+        label = glm::rotate(label, glm::radians(180.f), glm::vec3(0, 0, 1));
+        label = glm::scale(label, glm::vec3(0.01f));
+        label = glm::translate(label, glm::vec3(-1, -5, 0));
+        queue.submit(textMeshes.getProgram(), textMeshes.get(std::get<2>(combiPair), LABEL_TANGO), label, 1);
+
+        // Queue the tango Model
+        queue.submit(program, modelManager.getModelById(std::get<2>(combiPair)), glm::make_mat4(resultTransposedMatrix));
+    }
+}
+// One JSON line per frame: recognized monjis with corners and pose, found tangos
+void writeDetections(std::ofstream& out, int frameIndex, Tracker& tracker, MetaManager& metaManager) {
+    out << toJsonLine(detectionsToJson(frameIndex, tracker, metaManager)) << std::endl;
+}
 
-        // Rendering the tango Model
-        modelManager.getModelById(std::get<2>(combiPair)).draw(program);
+// Build and draw every label with one text backend, CPU and GPU time per drawn frame are printed
+void benchmarkText(std::string name, TextMeshCache& textMeshes, RenderQueue& queue) {
+    std::vector<std::pair<int, TextLabel>> labels = textMeshes.getAllLabels();
+    for (auto const& label : labels) {
+        textMeshes.get(label.first, label.second);
     }
+    glFinish();
+
+    // Half a meter in front of the camera, like a label on a marker
+    glm::mat4 place = glm::scale(glm::translate(glm::mat4(1.f), glm::vec3(0.f, 0.f, -0.5f)), glm::vec3(0.01f));
+
+    GLuint query;
+    glGenQueries(1, &query);
+    auto start = std::chrono::steady_clock::now();
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    for (int frame = 0; frame < TEXT_BENCHMARK_FRAMES; frame++) {
+        for (auto const& label : labels) {
+            queue.submit(textMeshes.getProgram(), textMeshes.get(label.first, label.second), place, 1);
+        }
+        queue.flush();
+    }
+    glEndQuery(GL_TIME_ELAPSED);
+    glFinish();
+    double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    GLuint64 gpuNs = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpuNs);
+    glDeleteQueries(1, &query);
+
+    std::cout << "[TextBenchmark] " << name << ": " << labels.size() << " labels built in "
+        << textMeshes.getBuildMs() << " ms, " << textMeshes.getIndexCount() << " vertices, "
+        << cpuMs / TEXT_BENCHMARK_FRAMES << " ms CPU / "
+        << gpuNs / 1e6 / TEXT_BENCHMARK_FRAMES << " ms GPU per frame" << std::endl;
 }
+
 int main(int argc, char** argv)
 {
     // Read the meta.json contains the possible kanjis and tangos 
@@ -214,105 +167,312 @@ int main(int argc, char** argv)
     // Init FTGL font for text rendering in 3d
     FTFont* font = initFTGL();
     
-    // Init OpenCV VideoStream read stream from camera
-    cv::VideoCapture capture(0);
-    if (!capture.isOpened()) {
-        std::cout << "Cannot open video: " << 0 << std::endl;
+    Options options = parseOptions(argc, argv);
+#ifndef ARKANJI_PROFILE
+    if (!options.trace.empty()) {
+        std::cout << "Built without profiling, reconfigure with -DARKANJI_PROFILE=ON for --trace" << std::endl;
+    }
+#endif
+    if (options.headless && !ARKANJI_HEADLESS) {
+        std::cout << "Built without headless support, reconfigure with -DARKANJI_HEADLESS=ON" << std::endl;
         exit(EXIT_FAILURE);
     }
-    cv::namedWindow("ARKanji - Tracking", cv::WINDOW_AUTOSIZE);
+
+    // Frames from camera, video file or image sequence, resized to the calibrated size
+    CameraIntrinsics intrinsics = options.calibration.empty() ? CameraIntrinsics() : loadCalibration(options.calibration);
+    int frameWidth = intrinsics.width, frameHeight = intrinsics.height;
+    FrameSource source(options.input, frameWidth, frameHeight, options.yuv ? FRAME_NV12 : FRAME_BGR);
 
     // Slider for setting B/W-Threshold value
-    int slider_value = 100;
-    cv::createTrackbar("Threshold", "ARKanji - Tracking", &slider_value, 255, on_trackbar, &slider_value);
-
-    // Init GLFW window 
-    GLFWwindow* window;
-    if (!glfwInit())
-        return -1;
-    window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, "ARKanji", NULL, NULL);
-    if (!window) {
-        glfwTerminate();
-        return -1;
+    int slider_value = options.threshold;
+    if (!options.headless) {
+        cv::namedWindow("ARKanji - Tracking", cv::WINDOW_AUTOSIZE);
+        cv::createTrackbar("Threshold", "ARKanji - Tracking", &slider_value, 255, on_trackbar, &slider_value);
     }
-    glfwSetFramebufferSizeCallback(window, setUpFrustum);
-    glfwMakeContextCurrent(window);
-    glfwSwapInterval(1);
 
-    // Setup Projection fov, etc 
-	setUpFrustum(window, WINDOW_WIDTH, WINDOW_HEIGHT);
-    
-    // Init GLEW / OpenGL
-    GLenum err = glewInit();
+    // Projection of the real camera and view of the frame
+    Camera camera;
+    camera.setIntrinsics(intrinsics);
+
+    // Composited frames are written at frame size, the window keeps the frame's aspect ratio
+    int windowWidth = WINDOW_WIDTH, windowHeight = WINDOW_WIDTH * frameHeight / frameWidth;
+
+    GLFWwindow* window = NULL;
+#if ARKANJI_HEADLESS
+    std::unique_ptr<OffscreenContext> offscreen;
+#endif
+    GLenum err = GLEW_OK;
+    if (options.headless) {
+#if ARKANJI_HEADLESS
+        // Offscreen context, GLEW must not look for a GLX display
+        offscreen.reset(new OffscreenContext(USE_CORE_PROFILE));
+        glewExperimental = GL_TRUE;
+        err = glewContextInit();
+#endif
+    }
+    else {
+        // Init GLFW window 
+        if (!glfwInit())
+            return -1;
+        if (USE_CORE_PROFILE) {
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+            glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+        }
+        window = glfwCreateWindow(windowWidth, windowHeight, "ARKanji", NULL, NULL);
+        if (!window) {
+            glfwTerminate();
+            return -1;
+        }
+        glfwSetFramebufferSizeCallback(window, setUpViewport);
+        glfwMakeContextCurrent(window);
+        glfwSwapInterval(1);
+
+        int framebufferWidth, framebufferHeight;
+        glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+        setUpViewport(window, framebufferWidth, framebufferHeight);
+
+        // Init GLEW / OpenGL, core profile entry points are only loaded with glewExperimental
+        glewExperimental = GL_TRUE;
+        err = glewInit();
+    }
     if (GLEW_OK != err)
     {
         std::cout << "GLEW initialisation error: " << glewGetErrorString(err) << std::endl;
         exit(-1);
     }
+    glGetError(); // glewInit queries GL_EXTENSIONS, which is an invalid enum in the core profile
     std::cout << "GLEW okay - using version: " << glewGetString(GLEW_VERSION) << std::endl;
+#if ARKANJI_HEADLESS
+    if (offscreen) {
+        offscreen->initFramebuffer(frameWidth, frameHeight);
+    }
+#endif
     initGL();
+    camera.init();
 
     // MetaManager instance
     // For loading Models of Monjis and Tangos
     MetaManager metaManager = MetaManager(meta);
 
-    // Generate String for Tesseract char whitelist
-    std::string whiteListKanjis = "";
-    for (int i = 0; i < metaManager.getMonjisSize(); i++) {
-        whiteListKanjis += metaManager.getKanjiById(i);
-    }
-
-    // Init Tesseract for Kanji recognition
-    tesseract::TessBaseAPI* api = initTesseract(whiteListKanjis);
+    // Init Tesseract for Kanji recognition, only the kanjis of meta.json are allowed
+    tesseract::TessBaseAPI* api = initTesseract(metaManager.getWhitelist());
 
     // Tracker instance 
     // api => Tesseract API for recognizing marker content
     // meta["monji"] => only needs recognizing monjis part 
     Tracker tracker = Tracker(api, meta["monji"]);
+    tracker.setDebugWindows(!options.headless);
+    tracker.setTablePlane(options.table);
+    tracker.setIntrinsics(intrinsics);
+    tracker.setPyramidLevels(options.pyramidLevels);
 
     // Compiled Shader program for rendering imported models with textures
     GLuint program = getShaderProgram(FRAGMENT_SHADER_PATH, VERTEX_SHADER_PATH);
+    metaManager.setShaderProgram(program);
+    camera.attach(program);
+
+    // Camera frame behind everything
+    GLuint backgroundProgram = getShaderProgram(options.yuv ? BACKGROUND_YUV_FRAGMENT_SHADER_PATH : BACKGROUND_FRAGMENT_SHADER_PATH,
+        BACKGROUND_VERTEX_SHADER_PATH);
+    Background background(backgroundProgram, frameWidth, frameHeight, options.yuv);
+
+    // Collects the model draws of a frame
+    RenderQueue renderQueue;
+
+    // Text of readings and tangos, built once per lexicon entry
+    TextMeshCache ftglMeshes(font, metaManager, program);
+    GLuint sdfProgram = getShaderProgram(SDF_FRAGMENT_SHADER_PATH, SDF_VERTEX_SHADER_PATH);
+    SdfFont sdfFont(FTGL_FONT_PATH, ftglMeshes.getAllTexts(), 1.5f);
+    TextMeshCache sdfMeshes(&sdfFont, metaManager, sdfProgram);
+    TextMeshCache& textMeshes = TEXT_BACKEND_SDF ? sdfMeshes : ftglMeshes;
+    camera.attach(sdfProgram);
+
+    // Resolve uniform locations now, nothing is queried from the GL inside the frame loop
+    renderQueue.getUniforms(program);
+    renderQueue.getUniforms(sdfProgram);
+    camera.upload();
+
+    if (TEXT_BENCHMARK) {
+        benchmarkText("FTGL", ftglMeshes, renderQueue);
+        benchmarkText("SDF", sdfMeshes, renderQueue);
+        std::cout << "[TextBenchmark] SDF atlas built in " << sdfFont.getBuildMs() << " ms" << std::endl;
+    }
+
+    // Composited frames and detections on disk
+    std::ofstream detections;
+    if (!options.detections.empty()) {
+        detections.open(options.detections);
+        if (!detections.is_open()) {
+            throw std::invalid_argument("Cannot write " + options.detections);
+        }
+    }
 
     // Feed-in frame from camera 
+    std::unique_ptr<MetricsExporter> metrics;
+    if (!options.metrics.empty()) {
+        metrics.reset(new MetricsExporter(options.metrics));
+    }
+
     cv::Mat frame;
+    int frameCount = 0;
+    int droppedInRow = 0;
+    auto start = std::chrono::steady_clock::now();
 
-    while (!glfwWindowShouldClose(window)) {
-        if (!capture.read(frame)) {
-            std::cout << "Cannot grab a frame." << std::endl;
+    while (window == NULL || !glfwWindowShouldClose(window)) {
+        PROFILE_SCOPE("frame");
+        if (options.maxFrames >= 0 && frameCount >= options.maxFrames) {
             break;
         }
-        capture >> frame; // Read in
+        bool grabbed;
+        {
+            PROFILE_SCOPE("capture");
+            grabbed = source.read(frame);
+        }
+        if (!grabbed) {
+            // Cameras may drop single frames, only give up when it keeps failing
+            if (source.isLive() && ++droppedInRow < MAX_DROPPED_FRAMES) {
+                if (metrics) {
+                    metrics->droppedFrame();
+                }
+                continue;
+            }
+            if (source.isLive()) {
+                std::cout << "Cannot grab a frame." << std::endl;
+            }
+            break;
+        }
+        droppedInRow = 0;
 
         // Track the current frame => Searching markers and recognizing kanjis
-        cv::Mat trackingFrame = tracker.track(frame, slider_value);
-        cv::imshow("ARKanji - Tracking", trackingFrame);
+        cv::Mat trackingFrame;
+        {
+            PROFILE_SCOPE("track");
+            // YUV input: the Y plane goes to the tracker as it is
+            trackingFrame = tracker.track(options.yuv ? FrameSource::luminance(frame) : frame, slider_value);
+        }
+        if (!options.headless) {
+            PROFILE_SCOPE("imshow");
+            cv::imshow("ARKanji - Tracking", trackingFrame);
+        }
+
+        // Seen monjis => models of their tangos should be resident before the combination shows up
+        for (auto const& marker : tracker.getDetectedMarkerCenter()) {
+            metaManager.prefetchTangosOf(marker.first);
+        }
 
         // Draw combination lines if combinable kanjis found
-        drawLines(tracker, metaManager, frame);
+        {
+            PROFILE_SCOPE("drawLines");
+            drawLines(tracker, metaManager, frame, options.yuv);
+        }
 
         // Render background by filling Camera frame
-        glUseProgram(0);
-        renderBackground(frame);
+        {
+            PROFILE_SCOPE("background");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            background.draw(frame);
+            camera.upload();
+        }
 
-        // Render Models and Yomikata-Instructions
-        glUseProgram(program);
-        renderObjs(tracker, metaManager, program, font);
+        {
+            PROFILE_SCOPE("queue");
+            // Queue Yomikata-Instructions and Models
+            renderObjs(tracker, metaManager, textMeshes, renderQueue, program);
 
-        // Render found Tangos
-        glUseProgram(program);
-        renderCombis(tracker, metaManager, program, font);
+            // Queue found Tangos
+            renderCombis(tracker, metaManager, textMeshes, renderQueue, program);
+        }
+
+        // Draw all queued Models sorted by program and texture
+        {
+            PROFILE_SCOPE("draw");
+            renderQueue.flush();
+        }
+
+        if (!options.output.empty()) {
+            PROFILE_SCOPE("output");
+            char name[32];
+            snprintf(name, sizeof(name), "/frame_%06d.png", frameCount);
+            int outputWidth = frameWidth, outputHeight = frameHeight;
+            if (window) {
+                glfwGetFramebufferSize(window, &outputWidth, &outputHeight);
+            }
+            cv::imwrite(options.output + name, readFramebuffer(outputWidth, outputHeight));
+        }
+        if (detections.is_open()) {
+            writeDetections(detections, frameCount, tracker, metaManager);
+        }
+        if (metrics) {
+            metrics->frame(tracker.getLastTimings(), (int)tracker.getDetectedMarkerCenter().size());
+            if (metrics->due()) {
+                const ModelCacheStats& modelStats = metaManager.getModelStats();
+                metrics->publish(metaManager.getModelBytes(), modelStats.hits, modelStats.misses);
+            }
+        }
 
         // Clean all maps of old frame
         tracker.cleanDetectedMarkers();
         monjiCombinations.clear();
 
         // Swap Buffers
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (window) {
+            PROFILE_SCOPE("swap");
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+
+        // Load prefetched models after the frame is presented
+        {
+            PROFILE_SCOPE("prefetch");
+            metaManager.servicePrefetch();
+        }
+
+        if (++frameCount % STATS_REPORT_INTERVAL == 0) {
+            metaManager.printModelStats();
+            const OcrCacheStats& ocrStats = tracker.getOcrCacheStats();
+            std::cout << "[OcrCache] hit rate " << ocrStats.hitRate() << ", hits " << ocrStats.hits << ", misses "
+                << ocrStats.misses << ", evictions " << ocrStats.evictions << ", saved " << ocrStats.savedMs << " ms" << std::endl;
+#ifdef ARKANJI_PROFILE
+            Profiler::printPercentiles();
+#endif
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << frameCount << " frames in " << seconds << " s, " << frameCount / seconds << " fps" << std::endl;
+
+#ifdef ARKANJI_PROFILE
+    Profiler::printPercentiles();
+    if (!options.trace.empty()) {
+        Profiler::writeChromeTrace(options.trace);
+    }
+#endif
+
+    // Last state before exit, the writer thread finishes it
+    if (metrics) {
+        const ModelCacheStats& modelStats = metaManager.getModelStats();
+        metrics->publish(metaManager.getModelBytes(), modelStats.hits, modelStats.misses);
+        metrics.reset();
     }
 
     // Termination Cleaning
-    glfwDestroyWindow(window);
-    glfwTerminate();
+    metaManager.printModelStats();
+    metaManager.releaseModels();
+    ftglMeshes.clear();
+    sdfMeshes.clear();
+    sdfFont.release();
+    background.release();
+    camera.release();
+    if (window) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+    }
+#if ARKANJI_HEADLESS
+    if (offscreen) {
+        offscreen->release();
+    }
+#endif
     return 0;
 }
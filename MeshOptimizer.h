@@ -0,0 +1,350 @@
+#pragma once
+
+// C / C++
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+// OpenGL
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+// Simulated post-transform cache size for reordering and reporting
+#define VERTEX_CACHE_SIZE 16
+
+// Positions are quantized to 16 bit when the rounding error stays below this fraction of the shortest triangle edge
+#define POSITION_QUANTIZATION_TOLERANCE 0.01f
+
+// Which vertex attributes the active shader actually reads
+struct VertexAttributes {
+    bool texcoord = true;
+    bool normal = true;
+
+    // Attributes which are optimized out by the compiler don't have a location
+    static VertexAttributes ofProgram(GLuint program) {
+        VertexAttributes attributes;
+        attributes.texcoord = glGetAttribLocation(program, "vTexcoord") >= 0;
+        attributes.normal = glGetAttribLocation(program, "vNormal") >= 0;
+        return attributes;
+    }
+};
+
+// Bounding box over all meshes of a model, positions are quantized relative to it
+struct QuantizationBox {
+    glm::vec3 center = glm::vec3(0.f);
+    glm::vec3 halfExtent = glm::vec3(1.f);
+    bool quantize = false;
+
+    // Maps quantized positions back into model space, multiply it into the model matrix
+    glm::mat4 dequantize() const {
+        glm::mat4 m(1.f);
+        if (quantize) {
+            m[0][0] = halfExtent.x;
+            m[1][1] = halfExtent.y;
+            m[2][2] = halfExtent.z;
+            m[3] = glm::vec4(center, 1.f);
+        }
+        return m;
+    }
+};
+
+// Interleaved vertex buffer and index buffer ready for upload
+struct OptimizedMesh {
+    std::vector<uint8_t> vertexData;
+    std::vector<uint8_t> indexData;
+    GLsizei stride = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // Attribute layout inside one interleaved vertex
+    GLenum positionType = GL_FLOAT;
+    GLenum texcoordType = GL_FLOAT;
+    GLint texcoordOffset = -1;  // -1 => attribute dropped
+    GLint normalOffset = -1;
+
+    // Report of the optimization
+    size_t bytesBefore = 0;
+    size_t bytesAfter = 0;
+    float acmrBefore = 0;       // Average cache miss ratio => vertex shader runs per triangle
+    float acmrAfter = 0;
+};
+
+namespace MeshOptimizer {
+
+    // Average cache miss ratio of a triangle list with a FIFO post-transform cache
+    inline float computeACMR(const std::vector<uint32_t>& index, size_t vertexCount, int cacheSize = VERTEX_CACHE_SIZE) {
+        if (index.size() < 3) {
+            return 0;
+        }
+        // Timestamp of the moment a vertex entered the cache
+        std::vector<size_t> cachedAt(vertexCount, 0);
+        size_t misses = 0;
+        for (uint32_t v : index) {
+            if (cachedAt[v] == 0 || misses - cachedAt[v] + 1 > (size_t)cacheSize) {
+                misses++;
+                cachedAt[v] = misses;
+            }
+        }
+        return (float)misses / (index.size() / 3);
+    }
+
+    // Tipsify (Sander et al. 2007): triangle order with good post-transform cache locality in linear time
+    inline std::vector<uint32_t> reorderTriangles(const std::vector<uint32_t>& index, size_t vertexCount, int cacheSize = VERTEX_CACHE_SIZE) {
+        size_t triangleCount = index.size() / 3;
+
+        // Vertex => adjacent triangles
+        std::vector<uint32_t> live(vertexCount, 0);
+        for (uint32_t v : index) {
+            live[v]++;
+        }
+        std::vector<uint32_t> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            offsets[v + 1] = offsets[v] + live[v];
+        }
+        std::vector<uint32_t> adjacency(index.size());
+        std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t t = 0; t < triangleCount; t++) {
+            for (int k = 0; k < 3; k++) {
+                adjacency[fill[index[t * 3 + k]]++] = (uint32_t)t;
+            }
+        }
+
+        std::vector<int> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<uint32_t> deadEnd;
+        std::vector<uint32_t> candidates;
+        std::vector<uint32_t> result;
+        result.reserve(index.size());
+
+        int time = cacheSize + 1;
+        size_t cursor = 0;
+        long fanning = vertexCount > 0 ? 0 : -1;
+
+        while (fanning >= 0) {
+            candidates.clear();
+
+            // Emit all remaining triangles around the fanning vertex
+            for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+                uint32_t t = adjacency[a];
+                if (emitted[t]) {
+                    continue;
+                }
+                for (int k = 0; k < 3; k++) {
+                    uint32_t v = index[t * 3 + k];
+                    result.push_back(v);
+                    deadEnd.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - cacheTime[v] > cacheSize) {
+                        cacheTime[v] = time;
+                        time++;
+                    }
+                }
+                emitted[t] = true;
+            }
+
+            // Next fanning vertex: one of the candidates which will still be in cache
+            fanning = -1;
+            int bestPriority = -1;
+            for (uint32_t v : candidates) {
+                if (live[v] == 0) {
+                    continue;
+                }
+                int priority = 0;
+                if (time - cacheTime[v] + 2 * (int)live[v] <= cacheSize) {
+                    priority = time - cacheTime[v];
+                }
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    fanning = v;
+                }
+            }
+
+            // Dead end => most recently used vertex with triangles left, else the next one in input order
+            while (fanning < 0 && !deadEnd.empty()) {
+                uint32_t v = deadEnd.back();
+                deadEnd.pop_back();
+                if (live[v] > 0) {
+                    fanning = v;
+                }
+            }
+            while (fanning < 0 && cursor < vertexCount) {
+                if (live[cursor] > 0) {
+                    fanning = (long)cursor;
+                }
+                cursor++;
+            }
+        }
+        return result;
+    }
+
+    // Renumber vertices in order of first use so vertex fetch walks the buffer linearly
+    // Returns old index => new index, unused vertices are mapped to UINT32_MAX
+    inline std::vector<uint32_t> reorderVertices(std::vector<uint32_t>& index, size_t vertexCount, size_t& usedCount) {
+        std::vector<uint32_t> remap(vertexCount, UINT32_MAX);
+        usedCount = 0;
+        for (uint32_t& v : index) {
+            if (remap[v] == UINT32_MAX) {
+                remap[v] = (uint32_t)usedCount++;
+            }
+            v = remap[v];
+        }
+        return remap;
+    }
+
+    /* computeQuantizationBox
+    * Bounding box over the positions of all meshes of a model
+    * @param indices : triangle lists of the meshes, same order as positions; models with details too fine for
+    *                  16 bit steps (shortest edge against the rounding error) keep float positions
+    */
+    inline QuantizationBox computeQuantizationBox(const std::vector<const std::vector<glm::vec3>*>& positions,
+        const std::vector<const std::vector<int>*>& indices) {
+        glm::vec3 lo(INFINITY), hi(-INFINITY);
+        for (const std::vector<glm::vec3>* meshPositions : positions) {
+            for (const glm::vec3& p : *meshPositions) {
+                lo = glm::min(lo, p);
+                hi = glm::max(hi, p);
+            }
+        }
+
+        QuantizationBox box;
+        if (lo.x > hi.x) {
+            return box;
+        }
+        box.center = (lo + hi) * 0.5f;
+        // Avoid a zero scale on flat models
+        box.halfExtent = glm::max((hi - lo) * 0.5f, glm::vec3(1e-6f));
+
+        // Shortest edge with a length, degenerate triangles don't count
+        float shortestEdge = INFINITY;
+        for (size_t m = 0; m < positions.size() && m < indices.size(); m++) {
+            const std::vector<glm::vec3>& p = *positions[m];
+            const std::vector<int>& index = *indices[m];
+            for (size_t t = 0; t + 2 < index.size(); t += 3) {
+                for (int e = 0; e < 3; e++) {
+                    float edge = glm::length(p[index[t + e]] - p[index[t + (e + 1) % 3]]);
+                    if (edge > 0.f) {
+                        shortestEdge = glm::min(shortestEdge, edge);
+                    }
+                }
+            }
+        }
+        // Rounding moves a vertex by at most half a step on every axis
+        float error = 0.5f * glm::length(box.halfExtent / 32767.f);
+        box.quantize = shortestEdge < INFINITY && error <= POSITION_QUANTIZATION_TOLERANCE * shortestEdge;
+        return box;
+    }
+
+    inline int16_t quantizeSnorm16(float v) {
+        return (int16_t)std::lround(glm::clamp(v, -1.f, 1.f) * 32767.f);
+    }
+
+    inline uint16_t quantizeUnorm16(float v) {
+        return (uint16_t)std::lround(glm::clamp(v, 0.f, 1.f) * 65535.f);
+    }
+
+    /* optimize
+    * Build an interleaved, quantized and cache-ordered vertex layout
+    * @param positions, texcoords, normals : planar vertex properties as imported
+    * @param index : triangle list
+    * @param box : model wide quantization box
+    * @param attributes : attributes read by the shader, the others are dropped
+    * @return buffers ready for upload
+    */
+    inline OptimizedMesh optimize(const std::vector<glm::vec3>& positions, const std::vector<glm::vec2>& texcoords,
+        const std::vector<glm::vec3>& normals, const std::vector<int>& index,
+        const QuantizationBox& box, const VertexAttributes& attributes) {
+        OptimizedMesh mesh;
+        size_t vertexCount = positions.size();
+
+        mesh.bytesBefore = positions.size() * sizeof(glm::vec3) + texcoords.size() * sizeof(glm::vec2) +
+            normals.size() * sizeof(glm::vec3) + index.size() * sizeof(GLuint);
+
+        std::vector<uint32_t> triangles(index.begin(), index.end());
+        mesh.acmrBefore = computeACMR(triangles, vertexCount);
+
+        // Post-transform cache order, then pre-transform fetch order
+        triangles = reorderTriangles(triangles, vertexCount);
+        size_t usedCount = 0;
+        std::vector<uint32_t> remap = reorderVertices(triangles, vertexCount, usedCount);
+        mesh.acmrAfter = computeACMR(triangles, usedCount);
+
+        // UVs outside of [0, 1] (mirrored repeat) keep full precision
+        bool quantizeUV = true;
+        for (const glm::vec2& uv : texcoords) {
+            if (uv.x < 0.f || uv.x > 1.f || uv.y < 0.f || uv.y > 1.f) {
+                quantizeUV = false;
+                break;
+            }
+        }
+
+        // Layout: position | texcoord | normal, every attribute aligned to 4 bytes
+        GLsizei positionSize = box.quantize ? 4 * sizeof(int16_t) : 3 * sizeof(float);
+        GLsizei texcoordSize = quantizeUV ? 2 * sizeof(uint16_t) : 2 * sizeof(float);
+        mesh.positionType = box.quantize ? GL_SHORT : GL_FLOAT;
+        mesh.texcoordType = quantizeUV ? GL_UNSIGNED_SHORT : GL_FLOAT;
+        mesh.stride = positionSize;
+        if (attributes.texcoord) {
+            mesh.texcoordOffset = mesh.stride;
+            mesh.stride += texcoordSize;
+        }
+        if (attributes.normal) {
+            mesh.normalOffset = mesh.stride;
+            mesh.stride += 3 * sizeof(float);
+        }
+
+        mesh.vertexData.assign(usedCount * mesh.stride, 0);
+        for (size_t v = 0; v < vertexCount; v++) {
+            if (remap[v] == UINT32_MAX) {
+                continue;
+            }
+            uint8_t* vertex = mesh.vertexData.data() + remap[v] * mesh.stride;
+
+            if (box.quantize) {
+                glm::vec3 p = (positions[v] - box.center) / box.halfExtent;
+                int16_t q[4] = { quantizeSnorm16(p.x), quantizeSnorm16(p.y), quantizeSnorm16(p.z), 0 };
+                memcpy(vertex, q, sizeof(q));
+            }
+            else {
+                memcpy(vertex, &positions[v], sizeof(glm::vec3));
+            }
+
+            if (attributes.texcoord) {
+                if (quantizeUV) {
+                    uint16_t q[2] = { quantizeUnorm16(texcoords[v].x), quantizeUnorm16(texcoords[v].y) };
+                    memcpy(vertex + mesh.texcoordOffset, q, sizeof(q));
+                }
+                else {
+                    memcpy(vertex + mesh.texcoordOffset, &texcoords[v], sizeof(glm::vec2));
+                }
+            }
+
+            if (attributes.normal) {
+                memcpy(vertex + mesh.normalOffset, &normals[v], sizeof(glm::vec3));
+            }
+        }
+
+        // 16 bit indices whenever all vertices are addressable
+        mesh.indexCount = (GLsizei)triangles.size();
+        if (usedCount <= 0xFFFF) {
+            mesh.indexType = GL_UNSIGNED_SHORT;
+            mesh.indexData.resize(triangles.size() * sizeof(uint16_t));
+            uint16_t* out = (uint16_t*)mesh.indexData.data();
+            for (size_t i = 0; i < triangles.size(); i++) {
+                out[i] = (uint16_t)triangles[i];
+            }
+        }
+        else {
+            mesh.indexType = GL_UNSIGNED_INT;
+            mesh.indexData.resize(triangles.size() * sizeof(uint32_t));
+            memcpy(mesh.indexData.data(), triangles.data(), mesh.indexData.size());
+        }
+
+        mesh.bytesAfter = mesh.vertexData.size() + mesh.indexData.size();
+        return mesh;
+    }
+}
@@ -1,198 +1,111 @@
+#pragma once
+
 // C / C++
 #include <exception>
+#include <map>
+#include <vector>
 
-// JSON
-#include <json/json.h>
-
-#include "Model.h"
+#include "Lexicon.h"
+#include "ModelCache.h"
 
-// Get Meta-information from meta.json 
-class MetaManager {
+// The lexicon plus the models of every monji and tango
+class MetaManager : public Lexicon {
     public:
-        MetaManager(Json::Value para_json) {
-            json = para_json;
-            monjis = para_json["monji"];
-            tangos = para_json["tango"];
-
-            // Load model for every monji 文字　もんじ
-            for (int i = 0; i < monjis.size(); i++) {
-                Model model;
-                model.load("../" + monjis[i]["model"].asString());
-                modelMap[monjis[i]["id"].asInt()] = model;
+        MetaManager(Json::Value para_json) : Lexicon(para_json) {
+            // Models are only loaded when they are detected, the budget limits how many stay resident
+            if (para_json.isMember("modelBudgetMB")) {
+                modelCache = ModelCache((size_t)para_json["modelBudgetMB"].asUInt() * 1024 * 1024);
             }
 
-            // Load model for every tango　単語　たんご
-            for (int i = 0; i < tangos.size(); i++) {
-                Model model;
-                model.load("../" + tangos[i]["model"].asString());
-                modelMap[tangos[i]["id"].asInt()] = model;
-            }
-        }
-         
-        int getMonjisSize() {
-            return monjis.size();
-        }
-
-        int getTangosSize() {
-            return tangos.size();
-        }
-
-        int getIdByKanji(std::string kanji) {
+            // Register model for every monji 文字　もんじ
             for (int i = 0; i < monjis.size(); i++) {
-                if (kanji.find(monjis[i]["kanji"].asString()) != std::string::npos) {
-                    return monjis[i]["id"].asInt();
-                }
+                modelCache.registerModel(monjis[i]["id"].asInt(), "../" + monjis[i]["model"].asString(), parseTransform(monjis[i]));
             }
-            return -1;
-        }
-
-        std::string getKanjiById(int id) {
-            for (int i = 0; i < monjis.size(); i++) {
-                if (id == monjis[i]["id"].asInt()) {
-                    return monjis[i]["kanji"].asString();
-                }
-            }
-            return "";
-        }
 
-        std::string getTangoById(int id) {
+            // Register model for every tango　単語　たんご
             for (int i = 0; i < tangos.size(); i++) {
-                if (id == tangos[i]["id"].asInt()) {
-                    return tangos[i]["kanji"].asString();
-                }
+                modelCache.registerModel(tangos[i]["id"].asInt(), "../" + tangos[i]["model"].asString(), parseTransform(tangos[i]));
             }
-            return "";
         }
-
-        Model getModelById(int id) {
+         
+        // Pointer lookup into the resident models, loads the model if it's not resident
+        ModelHandle getModelById(int id) {
             if (id < 0) {
                 throw std::invalid_argument("Id must be a postive integer.");
             }
-            return modelMap.at(id);
+            return modelCache.get(id);
         }
 
-        Model getModelById(std::string id) {
-            return modelMap.at(std::stoi(id));
+        ModelHandle getModelById(std::string id) {
+            return modelCache.get(std::stoi(id));
         }
 
-        Model getModelByKanji(std::string kanji) {
+        ModelHandle getModelByKanji(std::string kanji) {
             int id = getIdByKanji(kanji);
             return getModelById(id);
         }
 
-        // Find whether two monjis can form a tango, if yes return id of tango
-        int getTangoId(int id1, int id2) {
+        // Shader program the models are drawn with, decides which vertex attributes are uploaded
+        void setShaderProgram(GLuint program) {
+            modelCache.setVertexAttributes(VertexAttributes::ofProgram(program));
+        }
+
+        // A monji is seen => prefetch the models of every tango it can be part of
+        void prefetchTangosOf(int monjiId) {
             for (int i = 0; i < tangos.size(); i++) {
                 int tangoId = tangos[i]["id"].asInt();
-                if ((tangoId / 10) == id1 && (tangoId % 10) == id2) {
-                    return tangos[i]["id"].asInt();
+                if ((tangoId / 10) == monjiId || (tangoId % 10) == monjiId) {
+                    modelCache.prefetch(tangoId);
                 }
             }
-            return -1;
         }
 
-        // Return u8 encoded onyomi string
-        std::string getOnyomiById(int id) {
-            for (int i = 0; i < monjis.size(); i++) {
-                if (id == monjis[i]["id"].asInt()) {
-                    return monjis[i]["onyomi"].asString();
-                }
-            }
-            return "";
+        // Load queued models, should be called once per frame after rendering
+        void servicePrefetch() {
+            modelCache.servicePrefetch();
         }
 
-        // Return u8 encoded kunyomi string
-        std::string getKunyomiById(int id) {
-            for (int i = 0; i < monjis.size(); i++) {
-                if (id == monjis[i]["id"].asInt()) {
-                    return monjis[i]["kunyomi"].asString();
-                }
-            }
-            return "";
+        // Free all resident models before the GL context is destroyed
+        void releaseModels() {
+            modelCache.clear();
         }
 
-        // Hard-coded function for adjusting the models from internet
-        // All models are somehow not uniformly created in different scale and also rotation
-        // It would be more recommendable to use 3d modeling software to make all resources in same scale
-        // Since we only have few models, I write it here for understanding
-        glm::mat4 getModelTunningMatrix(int id, glm::mat4 mv) {
-            glm::mat4 tunning;
-            switch(id) {
-                case 1: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.0005, 0.0005, 0.0005));
-                    glm::mat4 rotate = glm::rotate(scale, glm::radians(-90.f), glm::vec3(1.0, 0.0, 0.0));
-                    tunning = rotate;
-                    break;
-                } 
-
-                case 2: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.0015, 0.0015, 0.0015));
-                    tunning = scale;
-                    break;
-                }
-
-                case 3: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.003, 0.003, 0.003));
-                    glm::mat4 rotate = glm::rotate(scale, glm::radians(180.f), glm::vec3(1.0, 0.0, 0.0));
-                    tunning = rotate;
-                    break;
-                }
-
-                case 4: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.018, 0.018, 0.018));
-                    glm::mat4 rotate = glm::rotate(scale, glm::radians(180.f), glm::vec3(1.0, 0.0, 0.0));
-                    glm::mat4 rotate2 = glm::rotate(rotate, glm::radians(90.f), glm::vec3(0.0, 0.0, 1.0));
-                    tunning = rotate2;
-                    break;
-                }
-
-                case 5: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.03, 0.03, 0.03));
-                    glm::mat4 rotate = glm::rotate(scale, glm::radians(180.f), glm::vec3(1.0, 0.0, 0.0));
-                    tunning = rotate;
-                    break;
-                }
-
-                case 6: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.001, 0.001, 0.001));
-                    glm::mat4 rotate = glm::rotate(scale, glm::radians(270.f), glm::vec3(1.0, 0.0, 0.0));
-                    glm::mat4 rotate2 = glm::rotate(rotate, glm::radians(180.f), glm::vec3(0.0, 1.0, 0.0));
-                    tunning = rotate2;
-                    break;
-                }
+        void printModelStats() {
+            modelCache.printStats();
+        }
 
-                case 31: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.001, 0.001, 0.001));
-                    glm::mat4 rotate = glm::rotate(scale, glm::radians(180.f), glm::vec3(1.0, 0.0, 0.0));
-                    tunning = rotate;
-                    break;
-                }
+        const ModelCacheStats& getModelStats() {
+            return modelCache.getStats();
+        }
 
-                case 24: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.01, 0.01, 0.01));
-                    glm::mat4 rotate = glm::rotate(scale, glm::radians(90.f), glm::vec3(1.0, 0.0, 0.0));
-                    tunning = rotate;
-                    break;
-                }
+        // GPU memory of all resident models
+        size_t getModelBytes() {
+            return modelCache.getResidentBytes();
+        }
 
-                case 56: {
-                    glm::mat4 scale = glm::scale(mv, glm::vec3(0.006, 0.006, 0.006));
-                    glm::mat4 rotate = glm::rotate(scale, glm::radians(180.f), glm::vec3(1.0, 0.0, 0.0));
-                    tunning = rotate;
-                    break;
-                }
+    private:
+        ModelCache modelCache;
 
-                default: {
-                    tunning = glm::mat4(1.f);
-                    break;
+        // Optional per model placement, models from the internet come in different scales and orientations
+        ModelTransform parseTransform(Json::Value entry) {
+            ModelTransform placement;
+            if (!entry.isMember("transform")) {
+                return placement;
+            }
+            Json::Value transform = entry["transform"];
+            if (transform.isMember("scale")) {
+                placement.autoScale = false;
+                placement.scale = transform["scale"].asFloat();
+            }
+            if (transform.isMember("rotate")) {
+                // List of [degrees, x, y, z], applied in order
+                placement.rotation = glm::mat4(1.f);
+                for (int i = 0; i < transform["rotate"].size(); i++) {
+                    Json::Value r = transform["rotate"][i];
+                    placement.rotation = glm::rotate(placement.rotation, glm::radians(r[0].asFloat()),
+                        glm::vec3(r[1].asFloat(), r[2].asFloat(), r[3].asFloat()));
                 }
             }
-            return tunning;
+            return placement;
         }
-
-    private:
-        Json::Value monjis;
-        Json::Value tangos;
-        Json::Value json;
-        std::map<int, Model> modelMap;
 };
\ No newline at end of file
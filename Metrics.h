@@ -0,0 +1,207 @@
+#pragma once
+
+// C / C++
+#include <chrono>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <unistd.h>
+#endif
+
+#include "Tracker.h"
+
+// Milliseconds between two rewrites of the metrics file
+#define METRICS_INTERVAL_MS 5000
+
+// Counters since start and gauges of the last interval
+struct MetricsSnapshot {
+    double uptimeSeconds = 0;
+    double fps = 0;
+    long long frames = 0;
+    long long droppedFrames = 0;
+    long long candidates = 0;
+    long long ocrCalls = 0;
+    long long ocrCacheHits = 0;
+    int markers = 0;                            // Tracked in the last frame
+    double stageSeconds[STAGE_COUNT + 1] = {};  // Tracker stages and the whole frame
+    long long modelHits = 0;
+    long long modelMisses = 0;
+    size_t gpuModelBytes = 0;
+};
+
+/* Live metrics for long running installations
+* The frame loop only adds a few numbers per frame, every METRICS_INTERVAL_MS a copy is handed to a
+* writer thread which formats the Prometheus text format and replaces the file atomically,
+* e.g. for the textfile collector of the node exporter.
+*/
+class MetricsExporter {
+    public:
+        MetricsExporter(std::string para_path) {
+            path = para_path;
+            start = std::chrono::steady_clock::now();
+            lastFrame = start;
+            lastPublish = start;
+            writer = std::thread(&MetricsExporter::run, this);
+        }
+
+        ~MetricsExporter() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            writer.join();
+        }
+
+        // Called once per frame after tracking
+        void frame(const TrackTimings& timings, int markers) {
+            auto now = std::chrono::steady_clock::now();
+            current.frames++;
+            current.candidates += timings.candidates;
+            current.ocrCalls += timings.ocrCalls;
+            current.ocrCacheHits += timings.ocrCacheHits;
+            current.markers = markers;
+            for (int stage = 0; stage < STAGE_COUNT; stage++) {
+                current.stageSeconds[stage] += timings.ms[stage] / 1000.0;
+            }
+            current.stageSeconds[STAGE_COUNT] += std::chrono::duration<double>(now - lastFrame).count();
+            lastFrame = now;
+        }
+
+        // A live source failed to deliver a frame
+        void droppedFrame() {
+            current.droppedFrames++;
+        }
+
+        // True when the next snapshot should be published
+        bool due() {
+            return std::chrono::steady_clock::now() - lastPublish >= std::chrono::milliseconds(METRICS_INTERVAL_MS);
+        }
+
+        // Hand the counters to the writer thread, gauges owned by others are passed in
+        void publish(size_t gpuModelBytes, long long modelHits, long long modelMisses) {
+            auto now = std::chrono::steady_clock::now();
+            double interval = std::chrono::duration<double>(now - lastPublish).count();
+            current.fps = interval > 0 ? (current.frames - publishedFrames) / interval : 0;
+            current.uptimeSeconds = std::chrono::duration<double>(now - start).count();
+            current.gpuModelBytes = gpuModelBytes;
+            current.modelHits = modelHits;
+            current.modelMisses = modelMisses;
+            publishedFrames = current.frames;
+            lastPublish = now;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending = current;
+                hasPending = true;
+            }
+            wake.notify_one();
+        }
+
+    private:
+        std::string path;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::time_point lastFrame;
+        std::chrono::steady_clock::time_point lastPublish;
+        long long publishedFrames = 0;
+        MetricsSnapshot current;    // Frame loop only
+
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable wake;
+        MetricsSnapshot pending;
+        bool hasPending = false;
+        bool stopping = false;
+
+        void run() {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                wake.wait(lock, [&]() { return hasPending || stopping; });
+                if (hasPending) {
+                    MetricsSnapshot snapshot = pending;
+                    hasPending = false;
+                    lock.unlock();
+                    write(snapshot);
+                    lock.lock();
+                }
+                if (stopping && !hasPending) {
+                    return;
+                }
+            }
+        }
+
+        // Resident set size (working set on Windows, /proc elsewhere), 0 where it is not available
+        static size_t residentBytes() {
+#ifdef _WIN32
+            PROCESS_MEMORY_COUNTERS counters;
+            if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+                return 0;
+            }
+            return (size_t)counters.WorkingSetSize;
+#else
+            std::ifstream statm("/proc/self/statm");
+            size_t pages = 0, resident = 0;
+            if (!(statm >> pages >> resident)) {
+                return 0;
+            }
+            long pageSize = sysconf(_SC_PAGESIZE);
+            return pageSize > 0 ? resident * (size_t)pageSize : 0;
+#endif
+        }
+
+        // Readers never see a partial file, the complete text is renamed over the old one
+        void write(const MetricsSnapshot& s) {
+            std::ostringstream out;
+            out.precision(12);
+            auto metric = [&](const char* name, const char* type, const char* help, double value) {
+                out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n"
+                    << name << " " << value << "\n";
+            };
+            metric("arkanji_uptime_seconds", "gauge", "Seconds since start.", s.uptimeSeconds);
+            metric("arkanji_fps", "gauge", "Frames per second over the last interval.", s.fps);
+            metric("arkanji_frames_total", "counter", "Processed frames.", (double)s.frames);
+            metric("arkanji_dropped_frames_total", "counter", "Frames the camera failed to deliver.", (double)s.droppedFrames);
+            metric("arkanji_candidates_total", "counter", "Quad candidates checked by the tracker.", (double)s.candidates);
+            metric("arkanji_ocr_calls_total", "counter", "Tesseract recognitions.", (double)s.ocrCalls);
+            metric("arkanji_ocr_cache_hits_total", "counter", "Recognitions taken from the OCR cache.", (double)s.ocrCacheHits);
+            metric("arkanji_markers_tracked", "gauge", "Markers recognized in the last frame.", s.markers);
+            metric("arkanji_model_cache_hits_total", "counter", "Models resident when requested.", (double)s.modelHits);
+            metric("arkanji_model_cache_misses_total", "counter", "Models loaded while rendering.", (double)s.modelMisses);
+            metric("arkanji_gpu_model_bytes", "gauge", "GPU buffers and textures of resident models.", (double)s.gpuModelBytes);
+            metric("arkanji_resident_memory_bytes", "gauge", "Resident set size of the process.", (double)residentBytes());
+
+            out << "# HELP arkanji_stage_seconds Time spent per stage, divide by frames for the mean latency.\n"
+                << "# TYPE arkanji_stage_seconds summary\n";
+            for (int stage = 0; stage <= STAGE_COUNT; stage++) {
+                const char* name = stage < STAGE_COUNT ? TRACK_STAGE_NAMES[stage] : "frame";
+                out << "arkanji_stage_seconds_sum{stage=\"" << name << "\"} " << s.stageSeconds[stage] << "\n"
+                    << "arkanji_stage_seconds_count{stage=\"" << name << "\"} " << s.frames << "\n";
+            }
+
+            std::string temporary = path + ".tmp";
+            {
+                std::ofstream file(temporary);
+                if (!file.is_open()) {
+                    return;
+                }
+                file << out.str();
+            }
+#ifdef _WIN32
+            // rename fails on Windows when the target exists
+            MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+            std::rename(temporary.c_str(), path.c_str());
+#endif
+        }
+};
@@ -3,6 +3,7 @@
 // C / C++
 #include <map>
 #include <vector>
+#include <memory>
 #include <iostream>
 
 // OpenGL
@@ -21,13 +22,11 @@
 #include <assimp/scene.h>
 #include <assimp/postprocess.h>
 
-// For rendering imported aiMesh
-class Mesh
-{
-public:
-    GLuint vao, vbo, ebo;
-    GLuint diffuseTexture; 
+#include "MeshOptimizer.h"
 
+// CPU-side vertex data of an imported aiMesh, only alive until it is optimized and uploaded
+struct MeshData
+{
     // Vertex Properties
     std::vector<glm::vec3> vertexPosition;
     std::vector<glm::vec2> vertexTexcoord;
@@ -35,71 +34,144 @@ public:
 
     // glDrawElements indexing
     std::vector<int> index;
+};
+
+// For rendering imported aiMesh, holds only the GPU-side draw data
+// Meshes are drawn through the RenderQueue
+class Mesh
+{
+public:
+    GLuint vao = 0, vbo = 0, ebo = 0;
+    GLuint diffuseTexture = 0;
+    GLsizei indexCount = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+
+    // Bytes uploaded into vbo and ebo
+    size_t gpuBytes = 0;
 
-    void bindData()
+    void bindData(const OptimizedMesh& data)
     {
         // Vertex array
-        glGenVertexArrays(1, &vao); 
-        glBindVertexArray(vao);  	
+        glGenVertexArrays(1, &vao);
+        glBindVertexArray(vao);
 
+        // Interleaved vertices => one buffer, one stride
         glGenBuffers(1, &vbo);
         glBindBuffer(GL_ARRAY_BUFFER, vbo);
-        glBufferData(GL_ARRAY_BUFFER,
-            vertexPosition.size() * sizeof(glm::vec3) +
-            vertexTexcoord.size() * sizeof(glm::vec2) +
-            vertexNormal.size() * sizeof(glm::vec3),
-            NULL, GL_STATIC_DRAW);
-
-        // Position
-        GLuint offset_position = 0;
-        GLuint size_position = vertexPosition.size() * sizeof(glm::vec3);
-        glBufferSubData(GL_ARRAY_BUFFER, offset_position, size_position, vertexPosition.data());
+        glBufferData(GL_ARRAY_BUFFER, data.vertexData.size(), data.vertexData.data(), GL_STATIC_DRAW);
+
+        // Position, quantized ones are normalized into the quantization box
+        GLint positionSize = data.positionType == GL_SHORT ? 4 : 3;
+        GLboolean positionNormalized = data.positionType == GL_SHORT ? GL_TRUE : GL_FALSE;
         glEnableVertexAttribArray(0);   // In shader (layout = 0) represents vertex pos
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(offset_position));
+        glVertexAttribPointer(0, positionSize, data.positionType, positionNormalized, data.stride, (GLvoid*)0);
 
         // UV coordinates
-        GLuint offset_texcoord = size_position;
-        GLuint size_texcoord = vertexTexcoord.size() * sizeof(glm::vec2);
-        glBufferSubData(GL_ARRAY_BUFFER, offset_texcoord, size_texcoord, vertexTexcoord.data());
-        glEnableVertexAttribArray(1);   // In shader (layout = 1) represents texture coords
-        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(offset_texcoord));
-
-        // Normals
-        GLuint offset_normal = size_position + size_texcoord;
-        GLuint size_normal = vertexNormal.size() * sizeof(glm::vec3);
-        glBufferSubData(GL_ARRAY_BUFFER, offset_normal, size_normal, vertexNormal.data());
-        glEnableVertexAttribArray(2);   // In shader (layout = 2) represents normals
-        glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 0, (GLvoid*)(offset_normal));
+        if (data.texcoordOffset >= 0) {
+            GLboolean texcoordNormalized = data.texcoordType == GL_UNSIGNED_SHORT ? GL_TRUE : GL_FALSE;
+            glEnableVertexAttribArray(1);   // In shader (layout = 1) represents texture coords
+            glVertexAttribPointer(1, 2, data.texcoordType, texcoordNormalized, data.stride, (GLvoid*)(intptr_t)data.texcoordOffset);
+        }
+
+        // Normals, only when the shader reads them
+        if (data.normalOffset >= 0) {
+            glEnableVertexAttribArray(2);   // In shader (layout = 2) represents normals
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, data.stride, (GLvoid*)(intptr_t)data.normalOffset);
+        }
 
         // Pass index to ebo
         glGenBuffers(1, &ebo);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, index.size() * sizeof(GLuint), index.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, data.indexData.size(), data.indexData.data(), GL_STATIC_DRAW);
 
         glBindVertexArray(0);
+
+        indexCount = data.indexCount;
+        indexType = data.indexType;
+        gpuBytes = data.vertexData.size() + data.indexData.size();
     }
-    void draw(GLuint program)
+
+    void release()
     {
-        glBindVertexArray(vao);
+        glDeleteBuffers(1, &vbo);
+        glDeleteBuffers(1, &ebo);
+        glDeleteVertexArrays(1, &vao);
+    }
+};
 
-        // Texturing
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, diffuseTexture);
-        glUniform1i(glGetUniformLocation(program, "texture"), 0);
+// Edge length a model is scaled to when meta.json gives no scale (marker is 0.041m)
+#define MODEL_TARGET_SIZE 0.05f
 
-        // Drawing
-        glDrawElements(GL_TRIANGLES, this->index.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+// Placement of a model on its marker, optionally overridden per model in meta.json:
+// "transform": { "scale": 0.001, "rotate": [[180, 1, 0, 0], [90, 0, 0, 1]] }
+// Without scale the bounding box is centered and scaled to MODEL_TARGET_SIZE,
+// without rotate the glTF Y-up axis is turned to the marker normal
+struct ModelTransform
+{
+    bool autoScale = true;
+    float scale = 1.f;
+    glm::mat4 rotation = glm::rotate(glm::mat4(1.f), glm::radians(-90.f), glm::vec3(1.0, 0.0, 0.0));
+
+    // Keep the model as it is
+    static ModelTransform identity()
+    {
+        ModelTransform placement;
+        placement.autoScale = false;
+        placement.rotation = glm::mat4(1.f);
+        return placement;
+    }
+
+    // Normalization matrix for a model with the given bounding box
+    glm::mat4 compute(glm::vec3 boundsMin, glm::vec3 boundsMax) const
+    {
+        if (!autoScale)
+        {
+            return glm::scale(glm::mat4(1.f), glm::vec3(scale)) * rotation;
+        }
+        glm::vec3 extent = boundsMax - boundsMin;
+        float maxExtent = glm::max(extent.x, glm::max(extent.y, extent.z));
+        float fitScale = maxExtent > 0.f ? MODEL_TARGET_SIZE / maxExtent : 1.f;
+        return glm::scale(glm::mat4(1.f), glm::vec3(fitScale)) * rotation *
+            glm::translate(glm::mat4(1.f), -(boundsMin + boundsMax) * 0.5f);
     }
 };
 
+// A loaded model owns its GL objects, so it can't be copied and frees them when destroyed
+// It is shared as an immutable ModelHandle after loading
 class Model
 {
 public:
     std::vector<Mesh> meshes;
     std::map<std::string, GLuint> textureMap;
+
+    // Bytes of all uploaded textures
+    size_t textureBytes = 0;
+
+    // Bounding box of all vertices as imported
+    glm::vec3 boundsMin = glm::vec3(0.f), boundsMax = glm::vec3(0.f);
+
+    // Quantized positions => multiply into the model matrix
+    glm::mat4 dequantize = glm::mat4(1.f);
+
+    // Normalization and dequantization baked into one matrix, set once at load
+    glm::mat4 transform = glm::mat4(1.f);
+
     Model() {}
-    void load(std::string filepath)
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    ~Model()
+    {
+        release();
+    }
+
+    /* load
+    * Import a model file, optimize its meshes and upload them
+    * @param filepath : path to the model file
+    * @param attributes : vertex attributes the shader reads, others are not uploaded
+    * @param placement : how the model is normalized onto the marker
+    */
+    void load(std::string filepath, VertexAttributes attributes = VertexAttributes(), ModelTransform placement = ModelTransform())
     {
         Assimp::Importer import;
         const aiScene* scene = import.ReadFile(filepath, aiProcess_Triangulate | aiProcess_FlipUVs);
@@ -110,11 +182,15 @@ public:
         // Path to model file, read from json
         std::string rootPath = filepath.substr(0, filepath.find_last_of('/'));
 
+        // CPU copy of the vertex data, freed after uploading
+        std::vector<MeshData> meshData(scene->mNumMeshes);
+
         // Load the meshes from imported scene (assimp)
         for (int i = 0; i < scene->mNumMeshes; i++)
         {
             meshes.push_back(Mesh());
             Mesh& mesh = meshes.back();
+            MeshData& data = meshData[i];
             aiMesh* aimesh = scene->mMeshes[i];
 
             // Init Mesh from aiMesh
@@ -125,13 +201,13 @@ public:
                 vvv.x = aimesh->mVertices[j].x;
                 vvv.y = aimesh->mVertices[j].y;
                 vvv.z = aimesh->mVertices[j].z;
-                mesh.vertexPosition.push_back(vvv);
+                data.vertexPosition.push_back(vvv);
 
                 // Normals
                 vvv.x = aimesh->mNormals[j].x;
                 vvv.y = aimesh->mNormals[j].y;
                 vvv.z = aimesh->mNormals[j].z;
-                mesh.vertexNormal.push_back(vvv);
+                data.vertexNormal.push_back(vvv);
 
                 // Textures
                 glm::vec2 vv(0, 0);
@@ -140,7 +216,7 @@ public:
                     vv.x = aimesh->mTextureCoords[0][j].x;
                     vv.y = aimesh->mTextureCoords[0][j].y;
                 }
-                mesh.vertexTexcoord.push_back(vv);
+                data.vertexTexcoord.push_back(vv);
             }
 
             // Materials
@@ -152,7 +228,7 @@ public:
                 aiString aistr;
                 material->GetTexture(aiTextureType_DIFFUSE, 0, &aistr);
                 std::string texpath = aistr.C_Str();
-                texpath = rootPath + '/' + texpath;  
+                texpath = rootPath + '/' + texpath;
 
                 if (textureMap.find(texpath) == textureMap.end())
                 {
@@ -168,6 +244,7 @@ public:
                     unsigned char* image = SOIL_load_image(texpath.c_str(), &textureWidth, &textureHeight, 0, SOIL_LOAD_RGB);
                     glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, textureWidth, textureHeight, 0, GL_RGB, GL_UNSIGNED_BYTE, image);   // 生成纹理
                     delete[] image;
+                    textureBytes += (size_t)textureWidth * textureHeight * 3;
 
                     textureMap[texpath] = tex;
                 }
@@ -180,20 +257,102 @@ public:
                 aiFace face = aimesh->mFaces[j];
                 for (GLuint k = 0; k < face.mNumIndices; k++)
                 {
-                    mesh.index.push_back(face.mIndices[k]);
+                    data.index.push_back(face.mIndices[k]);
                 }
             }
+        }
 
-            mesh.bindData();
+        upload(meshData, attributes, placement, filepath);
+    }
+
+    /* build
+    * Create a single mesh model from generated triangles, e.g. text geometry
+    * @param data : triangle list, freed after uploading
+    * @param texture : texture the mesh is drawn with, owned by the model afterwards
+    * @param attributes : vertex attributes the shader reads, others are not uploaded
+    * @param name : shown in the optimization report
+    */
+    void build(MeshData data, GLuint texture, VertexAttributes attributes, std::string name)
+    {
+        meshes.push_back(Mesh());
+        meshes.back().diffuseTexture = texture;
+        textureMap[name] = texture;
+
+        std::vector<MeshData> meshData;
+        meshData.push_back(std::move(data));
+        upload(meshData, attributes, ModelTransform::identity(), name);
+    }
+
+    // Memory held by this model on GPU side, used for the residency budget
+    size_t byteSize() const
+    {
+        size_t bytes = textureBytes;
+        for (const Mesh& mesh : meshes)
+        {
+            bytes += mesh.gpuBytes;
         }
+        return bytes;
     }
 
-    // Draw all formed meshes
-    void draw(GLuint program)
+    // Free all GL objects, the GL context has to be current
+    void release()
     {
+        for (Mesh& mesh : meshes)
+        {
+            mesh.release();
+        }
+        for (auto const& texture : textureMap)
+        {
+            glDeleteTextures(1, &texture.second);
+        }
+        meshes.clear();
+        textureMap.clear();
+        textureBytes = 0;
+    }
+
+private:
+    // Optimize the meshes of the model and upload them
+    void upload(std::vector<MeshData>& meshData, const VertexAttributes& attributes, const ModelTransform& placement, const std::string& name)
+    {
+        // One quantization box for all meshes => one dequantization matrix per model
+        std::vector<const std::vector<glm::vec3>*> positions;
+        std::vector<const std::vector<int>*> indices;
+        for (const MeshData& data : meshData)
+        {
+            positions.push_back(&data.vertexPosition);
+            indices.push_back(&data.index);
+        }
+        QuantizationBox box = MeshOptimizer::computeQuantizationBox(positions, indices);
+        dequantize = box.dequantize();
+        boundsMin = box.center - box.halfExtent;
+        boundsMax = box.center + box.halfExtent;
+        transform = placement.compute(boundsMin, boundsMax) * dequantize;
+
+        size_t bytesBefore = 0, bytesAfter = 0, triangles = 0;
+        float acmrBefore = 0, acmrAfter = 0;
         for (int i = 0; i < meshes.size(); i++)
         {
-            meshes[i].draw(program);
+            MeshData& data = meshData[i];
+            OptimizedMesh optimized = MeshOptimizer::optimize(data.vertexPosition, data.vertexTexcoord,
+                data.vertexNormal, data.index, box, attributes);
+            meshes[i].bindData(optimized);
+
+            bytesBefore += optimized.bytesBefore;
+            bytesAfter += optimized.bytesAfter;
+            acmrBefore += optimized.acmrBefore * (optimized.indexCount / 3);
+            acmrAfter += optimized.acmrAfter * (optimized.indexCount / 3);
+            triangles += optimized.indexCount / 3;
+            data = MeshData();
+        }
+
+        // Report what the optimization saved, ACMR ~ vertex shader invocations per triangle
+        if (triangles > 0)
+        {
+            std::cout << "[MeshOptimizer] " << name << ": " << bytesBefore / 1024 << " KB -> " << bytesAfter / 1024
+                << " KB, ACMR " << acmrBefore / triangles << " -> " << acmrAfter / triangles << std::endl;
         }
     }
 };
+
+// Shared immutable model, the GL objects live as long as the last handle
+typedef std::shared_ptr<const Model> ModelHandle;
@@ -0,0 +1,162 @@
+#pragma once
+
+// C / C++
+#include <map>
+#include <list>
+#include <set>
+#include <chrono>
+#include <string>
+#include <iostream>
+
+#include "Model.h"
+
+// Default budget for resident models (GPU buffers + textures), can be overridden by "modelBudgetMB" in meta.json
+#define MODEL_MEMORY_BUDGET (256 * 1024 * 1024)
+
+// Counters for reporting how well the residency works
+struct ModelCacheStats {
+    size_t hits = 0;        // Model was resident when requested
+    size_t misses = 0;      // Model had to be loaded while rendering => stall
+    size_t prefetches = 0;  // Model was loaded ahead of time
+    size_t evictions = 0;   // Model was dropped to stay under the budget
+    double stallMs = 0;     // Time the frame loop waited for missed models
+};
+
+// Keep models resident on demand under a memory budget
+// Models are shared as immutable handles, loaded lazily the first time they are requested
+// and the least recently used ones are evicted when the budget is exceeded. Loading needs the GL context, so everything runs on the render thread
+class ModelCache {
+    public:
+        ModelCache(size_t para_budget = MODEL_MEMORY_BUDGET) {
+            budget = para_budget;
+        }
+
+        // Remember where the model of an id lives and how it's placed, nothing is loaded yet
+        void registerModel(int id, std::string path, ModelTransform placement = ModelTransform()) {
+            paths[id] = path;
+            placements[id] = placement;
+        }
+
+        // Models loaded from now on only upload the attributes the shader reads
+        void setVertexAttributes(VertexAttributes para_attributes) {
+            attributes = para_attributes;
+        }
+
+        bool isRegistered(int id) {
+            return paths.find(id) != paths.end();
+        }
+
+        bool isResident(int id) {
+            return resident.find(id) != resident.end();
+        }
+
+        // Get a resident model, loading it now if it's not there (counted as stall)
+        ModelHandle get(int id) {
+            auto it = resident.find(id);
+            if (it != resident.end()) {
+                stats.hits++;
+                lru.splice(lru.begin(), lru, it->second.lruPos);
+                return it->second.model;
+            }
+
+            stats.misses++;
+            auto start = std::chrono::steady_clock::now();
+            ModelHandle model = load(id);
+            stats.stallMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            return model;
+        }
+
+        // Queue a model to be loaded later by servicePrefetch
+        void prefetch(int id) {
+            if (isRegistered(id) && !isResident(id)) {
+                pending.insert(id);
+            }
+        }
+
+        // Load at most maxLoads queued models, call once per frame outside of rendering
+        void servicePrefetch(int maxLoads = 1) {
+            while (maxLoads > 0 && !pending.empty()) {
+                int id = *pending.begin();
+                pending.erase(pending.begin());
+                if (isResident(id)) {
+                    continue;
+                }
+                load(id);
+                stats.prefetches++;
+                maxLoads--;
+            }
+        }
+
+        // Drop every resident model, must be called while the GL context is still alive
+        void clear() {
+            resident.clear();
+            lru.clear();
+            pending.clear();
+            residentBytes = 0;
+        }
+
+        const ModelCacheStats& getStats() {
+            return stats;
+        }
+
+        size_t getResidentBytes() {
+            return residentBytes;
+        }
+
+        void printStats() {
+            std::cout << "[ModelCache] resident " << resident.size() << "/" << paths.size()
+                << " models, " << residentBytes / (1024 * 1024) << "/" << budget / (1024 * 1024) << " MB"
+                << ", hits " << stats.hits << ", misses " << stats.misses
+                << ", prefetches " << stats.prefetches << ", evictions " << stats.evictions
+                << ", stall " << stats.stallMs << " ms" << std::endl;
+        }
+
+    private:
+        struct Entry {
+            ModelHandle model;
+            size_t bytes;
+            std::list<int>::iterator lruPos;
+        };
+
+        size_t budget;
+        size_t residentBytes = 0;
+        std::map<int, std::string> paths;
+        std::map<int, ModelTransform> placements;
+        std::map<int, Entry> resident;
+        std::list<int> lru;         // Front is most recently used
+        std::set<int> pending;      // Ids waiting for prefetch
+        ModelCacheStats stats;
+        VertexAttributes attributes;
+
+        ModelHandle load(int id) {
+            // A model that fails to load frees its GL objects on destruction
+            std::shared_ptr<Model> model = std::make_shared<Model>();
+            model->load(paths.at(id), attributes, placements.at(id));
+
+            Entry& entry = resident[id];
+            entry.model = model;
+            entry.bytes = model->byteSize();
+            lru.push_front(id);
+            entry.lruPos = lru.begin();
+            residentBytes += entry.bytes;
+            pending.erase(id);
+
+            evict(id);
+            return entry.model;
+        }
+
+        // Drop least recently used models until the budget fits, never the one just loaded
+        void evict(int keepId) {
+            while (residentBytes > budget && lru.size() > 1) {
+                int id = lru.back();
+                if (id == keepId) {
+                    break;
+                }
+                // GL objects are freed once no handle refers to the model anymore
+                residentBytes -= resident.at(id).bytes;
+                lru.pop_back();
+                resident.erase(id);
+                stats.evictions++;
+            }
+        }
+};
@@ -0,0 +1,158 @@
+#pragma once
+
+// C / C++
+#include <array>
+#include <algorithm>
+#include <vector>
+#include <bitset>
+#include <cstdint>
+
+// OpenCV
+#include <opencv2/core.hpp>
+
+// Recognitions remembered, the least recently used one is replaced
+#define OCR_CACHE_SIZE 64
+// Differing hash bits (of 256) still counted as the same marker, at most half of the entry's set bits.
+// Checked on the lexicon markers in etc/ run through the tracker's normalization: the closest two glyphs
+// are 32 bits apart (本/車, then 電/車 33, all others 47+), shifting the crop one pixel sideways changes
+// up to 10 bits (花; 17 diagonally, 26 for two pixels). Below 16, no hash is in reach of two different glyphs.
+#define OCR_CACHE_MAX_DISTANCE 12
+// Hits after which an entry is dropped and Tesseract runs again, a misread can't stick for longer
+#define OCR_CACHE_MAX_HITS 30
+
+// Counters for reporting how much recognition the cache saves
+struct OcrCacheStats {
+    long long hits = 0;         // Recognition result taken from the cache
+    long long misses = 0;       // Tesseract had to run
+    long long evictions = 0;    // Entry replaced to stay at OCR_CACHE_SIZE
+    double missMs = 0;          // Time spent in Tesseract on misses
+    double savedMs = 0;         // Hits times the mean recognition time of a miss
+
+    double hitRate() const {
+        return hits + misses > 0 ? (double)hits / (hits + misses) : 0;
+    }
+};
+
+/* Recognition results of recently seen marker images
+* The key is a perceptual hash of the normalized (warped, thresholded, eroded, rotated) 100x100 marker:
+* one bit per cell of a 16x16 grid, set when the cell is mostly dark. A marker seen again, e.g. picked up
+* and put back, lands within a few bits of its entry even though its crop is never pixel identical.
+* Only recognized kanjis are stored: a blurred or covered marker that failed once is tried again next frame.
+* Sparse glyphs (火 sets 8 cells) only match within half of their set bits, a nearly empty crop can't hit them.
+* Storage is allocated once, lookups and inserts scan the entries and never allocate.
+*/
+class OcrCache {
+    public:
+        typedef std::array<uint64_t, 4> Hash;
+
+        OcrCache() {
+            entries.resize(OCR_CACHE_SIZE);
+        }
+
+        // 16x16 mean of an 8 bit marker image, dark cells are set
+        static Hash hash(const cv::Mat& marker) {
+            CV_Assert(marker.type() == CV_8UC1);
+            int sums[256] = {};
+            int counts[256] = {};
+            for (int y = 0; y < marker.rows; y++) {
+                const uchar* row = marker.ptr<uchar>(y);
+                int cellRow = y * 16 / marker.rows * 16;
+                for (int x = 0; x < marker.cols; x++) {
+                    int cell = cellRow + x * 16 / marker.cols;
+                    sums[cell] += row[x];
+                    counts[cell]++;
+                }
+            }
+            Hash bits = {};
+            for (int cell = 0; cell < 256; cell++) {
+                if (counts[cell] > 0 && sums[cell] < 128 * counts[cell]) {
+                    bits[cell / 64] |= (uint64_t)1 << (cell % 64);
+                }
+            }
+            return bits;
+        }
+
+        static int distance(const Hash& a, const Hash& b) {
+            int bits = 0;
+            for (int i = 0; i < 4; i++) {
+                bits += (int)std::bitset<64>(a[i] ^ b[i]).count();
+            }
+            return bits;
+        }
+
+        /* lookup
+        * @param result : recognition stored with the closest entry in reach (see OCR_CACHE_MAX_DISTANCE)
+        * @return true on a hit, the entry becomes the most recently used one
+        */
+        bool lookup(const Hash& key, int& result) {
+            int best = -1, bestDistance = OCR_CACHE_MAX_DISTANCE + 1;
+            for (int i = 0; i < (int)entries.size(); i++) {
+                if (!entries[i].used) {
+                    continue;
+                }
+                int d = distance(entries[i].key, key);
+                if (d < bestDistance && d <= entries[i].reach) {
+                    best = i;
+                    bestDistance = d;
+                }
+            }
+            if (best == -1) {
+                return false;
+            }
+            // Served long enough, the caller recognizes the marker again and stores the fresh result
+            if (++entries[best].hits > OCR_CACHE_MAX_HITS) {
+                entries[best].used = false;
+                return false;
+            }
+            stats.hits++;
+            stats.savedMs += stats.misses > 0 ? stats.missMs / stats.misses : 0;
+            entries[best].lastUse = ++clock;
+            result = entries[best].result;
+            return true;
+        }
+
+        // Count a miss, recognitionMs is what Tesseract took for it; only a recognized kanji (result >= 0) is stored
+        void insert(const Hash& key, int result, double recognitionMs) {
+            stats.misses++;
+            stats.missMs += recognitionMs;
+            if (result < 0) {
+                return;
+            }
+            int victim = 0;
+            for (int i = 1; i < (int)entries.size() && entries[victim].used; i++) {
+                if (!entries[i].used || entries[i].lastUse < entries[victim].lastUse) {
+                    victim = i;
+                }
+            }
+            if (entries[victim].used) {
+                stats.evictions++;
+            }
+            int bits = distance(key, Hash());
+            entries[victim] = { key, result, std::min(OCR_CACHE_MAX_DISTANCE, bits / 2), 0, ++clock, true };
+        }
+
+        // Forget all entries, e.g. when the lexicon or the threshold changes; the counters stay
+        void clear() {
+            for (Entry& entry : entries) {
+                entry.used = false;
+            }
+        }
+
+        const OcrCacheStats& getStats() const {
+            return stats;
+        }
+
+    private:
+        struct Entry {
+            Hash key;
+            int result;             // Caller's recognition, e.g. a lexicon index
+            int reach;              // Largest distance still matching
+            int hits;               // Since it was stored
+            long long lastUse;
+            bool used;
+        };
+
+        std::vector<Entry> entries;
+        long long clock = 0;
+        OcrCacheStats stats;
+};
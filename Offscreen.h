@@ -0,0 +1,116 @@
+#pragma once
+
+// C / C++
+#include <stdexcept>
+
+// OpenGL
+#include <GL/glew.h>
+
+// EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// GL context without window or display server for headless runs
+// Uses the Mesa surfaceless platform when available, so llvmpipe software rendering works on plain servers,
+// everything is drawn into a framebuffer object of the window size
+class OffscreenContext {
+    public:
+        /* OffscreenContext
+        * Create and make current an OpenGL 3.3 context
+        * @param coreProfile : core or compatibility profile
+        */
+        OffscreenContext(bool coreProfile) {
+            PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+                (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+            if (getPlatformDisplay) {
+                display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            }
+            if (display == EGL_NO_DISPLAY) {
+                display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            }
+            EGLint major, minor;
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor)) {
+                throw std::runtime_error("Cannot initialize EGL display");
+            }
+
+            EGLint configAttributes[] = {
+                EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                EGL_NONE
+            };
+            EGLConfig config;
+            EGLint count = 0;
+            if (!eglChooseConfig(display, configAttributes, &config, 1, &count) || count == 0) {
+                throw std::runtime_error("No EGL config for desktop OpenGL");
+            }
+
+            eglBindAPI(EGL_OPENGL_API);
+            EGLint contextAttributes[] = {
+                EGL_CONTEXT_MAJOR_VERSION_KHR, 3,
+                EGL_CONTEXT_MINOR_VERSION_KHR, 3,
+                EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, coreProfile ?
+                    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR : EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT_KHR,
+                EGL_NONE
+            };
+            context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttributes);
+            if (context == EGL_NO_CONTEXT) {
+                throw std::runtime_error("Cannot create EGL context");
+            }
+            // No surface at all, needs EGL_KHR_surfaceless_context
+            if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context)) {
+                throw std::runtime_error("Cannot make EGL context current");
+            }
+        }
+
+        ~OffscreenContext() {
+            release();
+            if (context != EGL_NO_CONTEXT) {
+                eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                eglDestroyContext(display, context);
+            }
+            if (display != EGL_NO_DISPLAY) {
+                eglTerminate(display);
+            }
+        }
+
+        OffscreenContext(const OffscreenContext&) = delete;
+        OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+        // Color and depth render target, needs the GL functions loaded (glewContextInit)
+        void initFramebuffer(int width, int height) {
+            glGenFramebuffers(1, &fbo);
+            glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+
+            glGenRenderbuffers(1, &color);
+            glBindRenderbuffer(GL_RENDERBUFFER, color);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, color);
+
+            glGenRenderbuffers(1, &depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depth);
+
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+                throw std::runtime_error("Offscreen framebuffer is incomplete");
+            }
+            glViewport(0, 0, width, height);
+        }
+
+        // Delete the framebuffer, must be called while the context is still current
+        void release() {
+            if (fbo) {
+                glDeleteFramebuffers(1, &fbo);
+                glDeleteRenderbuffers(1, &color);
+                glDeleteRenderbuffers(1, &depth);
+                fbo = color = depth = 0;
+            }
+        }
+
+    private:
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+        GLuint fbo = 0;
+        GLuint color = 0;
+        GLuint depth = 0;
+};
@@ -848,13 +848,14 @@ void optimizePose(float* pRotation, float* pTranslation, int nPoints, const CvPo
 
 	float paramDiff[7];
 
-	vector< CvPoint2D32f > estMeasurements(nPoints);
+	// On the stack for the usual 4 points, the tracker calls this every frame
+	cv::AutoBuffer< CvPoint2D32f, 16 > estMeasurements(nPoints);
 
-	vector< float > jacobian(nPoints * 2 * 7);
+	cv::AutoBuffer< float, 4 * 2 * 7 > jacobian(nPoints * 2 * 7);
 
-	vector< float > measurementDiffPrev(nPoints * 2);
+	cv::AutoBuffer< float, 16 > measurementDiffPrev(nPoints * 2);
 
-	vector< float > measurementDiffNew(nPoints * 2);
+	cv::AutoBuffer< float, 16 > measurementDiffNew(nPoints * 2);
 
 	float MDiff2[7];
 
@@ -1040,9 +1041,9 @@ void optimizePose(float* pRotation, float* pTranslation, int nPoints, const CvPo
 
 
 
-void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize) {
+void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize, float focalLength) {
 
-	CvPoint2D32f *p2D = new CvPoint2D32f[4];
+	CvPoint2D32f p2D[4];
 
 	for (size_t i = 0; i<4; i++) {
 
@@ -1052,9 +1053,7 @@ void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize
 
 	}
 
-	estimateSquarePose_(result, p2D, markerSize);
-
-	delete p2D;
+	estimateSquarePose_(result, p2D, markerSize, focalLength);
 
 };
 
@@ -1070,16 +1069,16 @@ void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize
 
 * @param markerSize side-length of marker. Origin is at marker center.
 
+* @param focalLength focal length in pixels
+
 */
 
-void estimateSquarePose_(float* mat, CvPoint2D32f* p2D, float markerSize)
+void estimateSquarePose_(float* mat, CvPoint2D32f* p2D, float markerSize, float focalLength)
 
 {
 
-	// approximate focal length for logitech quickcam 4000 at 320*240 resolution
-
-	// approx for laptop internal camera with resolution 640x480
-	static const float fFocalLength = 634.0;
+	// comes from the calibration, 634 approximates a laptop internal camera at 640x480
+	const float fFocalLength = focalLength;
 
 
 
@@ -1422,3 +1421,118 @@ void calcHomography(float* pResult, const CvPoint2D32f* pQuad)
 	}
 
 }
+
+cv::Mat interpolatePose(const cv::Mat& poseA, const cv::Mat& poseB, float t)
+{
+	cv::Mat rotationA = poseA(cv::Rect(0, 0, 3, 3));
+	cv::Mat rotationB = poseB(cv::Rect(0, 0, 3, 3));
+
+	// Scaling the axis-angle of the relative rotation is the slerp between both orientations
+	cv::Mat axisAngle, partial;
+	cv::Rodrigues(cv::Mat(rotationA.t() * rotationB), axisAngle);
+	cv::Rodrigues(cv::Mat(axisAngle * t), partial);
+
+	cv::Mat result = cv::Mat::eye(4, 4, CV_32F);
+	cv::Mat(rotationA * partial).copyTo(result(cv::Rect(0, 0, 3, 3)));
+	cv::Mat(poseA(cv::Rect(3, 0, 1, 3)) * (1 - t) + poseB(cv::Rect(3, 0, 1, 3)) * t).copyTo(result(cv::Rect(3, 0, 1, 3)));
+	return result;
+}
+
+bool estimateTablePoses(float* results, const cv::Point2f* p2D, int count, float markerSize, float focalLength)
+{
+	// same camera as estimateSquarePose_, it looks down -z
+	const double fFocalLength = focalLength;
+	if (count <= 0) {
+		return false;
+	}
+
+	// Viewing rays of all corners
+	std::vector<cv::Vec3d> rays(4 * count);
+	for (int i = 0; i < 4 * count; i++) {
+		rays[i] = cv::Vec3d(p2D[i].x, p2D[i].y, -fFocalLength);
+	}
+
+	// The planes through the camera and two parallel marker edges meet in the 3D direction of these edges.
+	// Every edge direction lies in the table plane, so its normal is the direction least aligned with all of them.
+	// Larger markers give more reliable directions and are weighted by their size in the image.
+	cv::Matx33d scatter = cv::Matx33d::zeros();
+	std::vector<double> weights(count);
+	for (int m = 0; m < count; m++) {
+		const cv::Vec3d* r = &rays[4 * m];
+		const cv::Point2f* c = &p2D[4 * m];
+		double perimeter = 0;
+		for (int i = 0; i < 4; i++) {
+			perimeter += cv::norm(c[(i + 1) % 4] - c[i]);
+		}
+		weights[m] = perimeter * perimeter;
+
+		cv::Vec3d directionX = (r[0].cross(r[3])).cross(r[1].cross(r[2]));
+		cv::Vec3d directionY = (r[1].cross(r[0])).cross(r[2].cross(r[3]));
+		for (const cv::Vec3d& direction : { directionX, directionY }) {
+			double length = cv::norm(direction);
+			if (length > 0) {
+				cv::Vec3d d = direction / length;
+				scatter += weights[m] * (cv::Matx31d(d) * d.t());
+			}
+		}
+	}
+	cv::Mat eigenvalues, eigenvectors;
+	cv::eigen(cv::Mat(scatter), eigenvalues, eigenvectors);
+	cv::Vec3d normal(eigenvectors.at<double>(2, 0), eigenvectors.at<double>(2, 1), eigenvectors.at<double>(2, 2));
+
+	// Plane n.X = h with the camera on the negative side, so every ray hits it at positive distance
+	double facing = 0;
+	for (const cv::Vec3d& ray : rays) {
+		facing += normal.dot(ray);
+	}
+	if (facing < 0) {
+		normal = -normal;
+	}
+	for (const cv::Vec3d& ray : rays) {
+		if (normal.dot(ray) <= 1e-9) {
+			return false;
+		}
+	}
+
+	// Distance of the plane from the known marker size: corners intersected with n.X = 1 give markers of side length 1/h
+	double weightedDistance = 0, weightSum = 0;
+	for (int m = 0; m < count; m++) {
+		cv::Vec3d corners[4];
+		for (int i = 0; i < 4; i++) {
+			corners[i] = rays[4 * m + i] / normal.dot(rays[4 * m + i]);
+		}
+		double side = 0;
+		for (int i = 0; i < 4; i++) {
+			side += cv::norm(corners[(i + 1) % 4] - corners[i]) / 4;
+		}
+		weightedDistance += weights[m] * markerSize / side;
+		weightSum += weights[m];
+	}
+	double distance = weightedDistance / weightSum;
+
+	// Marker axes like estimateSquarePose_: corner 0 (-x, +y), 1 (-x, -y), 2 (+x, -y), 3 (+x, +y), z towards the camera
+	cv::Vec3d axisZ = -normal;
+	for (int m = 0; m < count; m++) {
+		cv::Vec3d corners[4];
+		cv::Vec3d center(0, 0, 0);
+		for (int i = 0; i < 4; i++) {
+			corners[i] = rays[4 * m + i] * (distance / normal.dot(rays[4 * m + i]));
+			center += corners[i] / 4.0;
+		}
+		cv::Vec3d edgeX = (corners[3] - corners[0]) + (corners[2] - corners[1]);
+		cv::Vec3d axisX = edgeX - axisZ * axisZ.dot(edgeX);
+		axisX /= cv::norm(axisX);
+		cv::Vec3d axisY = axisZ.cross(axisX);
+
+		float* mat = results + 16 * m;
+		for (int row = 0; row < 3; row++) {
+			mat[4 * row + 0] = (float)axisX[row];
+			mat[4 * row + 1] = (float)axisY[row];
+			mat[4 * row + 2] = (float)axisZ[row];
+			mat[4 * row + 3] = (float)center[row];
+		}
+		mat[12] = mat[13] = mat[14] = 0;
+		mat[15] = 1;
+	}
+	return true;
+}
@@ -22,15 +22,17 @@
 
 * @param markerSize side-length of marker. Origin is at marker center.
 
+* @param focalLength focal length in pixels, 634 fits a laptop camera at 640x480
+
 */
 
-void estimateSquarePose_(float* result, CvPoint2D32f* p2D, float markerSize);
+void estimateSquarePose_(float* result, CvPoint2D32f* p2D, float markerSize, float focalLength = 634.0f);
 
 
 
 
 
-void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize);
+void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize, float focalLength = 634.0f);
 
 /**
 
@@ -44,3 +46,22 @@ void estimateSquarePose(float* result, const cv::Point2f* p2D_, float markerSize
 
 void calcHomography(float* pResult, const CvPoint2D32f* pQuad);
 
+
+/**
+* interpolates between two poses: translation linearly, rotation by slerp
+* @param poseA, poseB 4x4 CV_32F poses as written by estimateSquarePose
+* @param t 0 gives poseA, 1 gives poseB
+* @return 4x4 CV_32F pose
+*/
+cv::Mat interpolatePose(const cv::Mat& poseA, const cv::Mat& poseB, float t);
+
+/**
+* estimates the plane all markers lie on jointly, then the pose of every marker on it in closed form
+* @param results 16 floats per marker, 4x4 row-major like estimateSquarePose
+* @param p2D 4 corners per marker, same order and coordinates as for estimateSquarePose
+* @param count number of markers
+* @param markerSize side-length of all markers
+* @param focalLength focal length in pixels
+* @return false when the plane can't be determined, results are untouched then
+*/
+bool estimateTablePoses(float* results, const cv::Point2f* p2D, int count, float markerSize, float focalLength = 634.0f);
@@ -0,0 +1,171 @@
+#pragma once
+
+// C / C++
+#include <chrono>
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+
+// Events kept per thread, the oldest are overwritten
+#define PROFILE_BUFFER_EVENTS 65536
+// Latest durations per scope name used for the percentiles
+#define PROFILE_WINDOW 600
+
+/* Scoped timers for frame stages, enabled with the ARKANJI_PROFILE CMake option
+* PROFILE_SCOPE("name") times the enclosing block, PROFILE_RECORD(name, start, end) adds a measured span.
+* Every thread writes into its own ring buffer without locking, names must be string literals.
+* Without ARKANJI_PROFILE both macros compile to nothing.
+*/
+#ifdef ARKANJI_PROFILE
+
+namespace Profiler {
+    typedef std::chrono::steady_clock Clock;
+
+    struct Event {
+        const char* name;
+        Clock::time_point start;
+        Clock::time_point end;
+    };
+
+    struct ThreadBuffer {
+        uint32_t tid;
+        std::vector<Event> events;
+        size_t next = 0;
+        bool wrapped = false;
+    };
+
+    inline std::mutex& registryMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    inline std::vector<std::shared_ptr<ThreadBuffer>>& registry() {
+        static std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        return buffers;
+    }
+
+    // Timestamps in the trace are relative to the first use
+    inline Clock::time_point epoch() {
+        static Clock::time_point start = Clock::now();
+        return start;
+    }
+
+    // Only the first call on a thread takes the lock
+    inline ThreadBuffer& threadBuffer() {
+        thread_local std::shared_ptr<ThreadBuffer> buffer;
+        if (!buffer) {
+            epoch();
+            buffer = std::make_shared<ThreadBuffer>();
+            buffer->events.resize(PROFILE_BUFFER_EVENTS);
+            std::lock_guard<std::mutex> lock(registryMutex());
+            buffer->tid = (uint32_t)registry().size();
+            registry().push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    inline void record(const char* name, Clock::time_point start, Clock::time_point end) {
+        ThreadBuffer& buffer = threadBuffer();
+        buffer.events[buffer.next] = { name, start, end };
+        if (++buffer.next == buffer.events.size()) {
+            buffer.next = 0;
+            buffer.wrapped = true;
+        }
+    }
+
+    class ScopedTimer {
+        public:
+            ScopedTimer(const char* para_name) : name(para_name), start(Clock::now()) {}
+            ~ScopedTimer() {
+                record(name, start, Clock::now());
+            }
+
+        private:
+            const char* name;
+            Clock::time_point start;
+    };
+
+    // Events of one thread, oldest first
+    inline std::vector<Event> ordered(const ThreadBuffer& buffer) {
+        std::vector<Event> events;
+        if (buffer.wrapped) {
+            events.insert(events.end(), buffer.events.begin() + buffer.next, buffer.events.end());
+        }
+        events.insert(events.end(), buffer.events.begin(), buffer.events.begin() + buffer.next);
+        return events;
+    }
+
+    // Chrome trace-event JSON, open with chrome://tracing or Perfetto
+    // Reads the buffers of all threads, other threads should not be recording meanwhile
+    inline void writeChromeTrace(const std::string& path) {
+        std::ofstream out(path);
+        out << "{\"traceEvents\":[";
+        bool first = true;
+        std::lock_guard<std::mutex> lock(registryMutex());
+        for (auto const& buffer : registry()) {
+            for (const Event& event : ordered(*buffer)) {
+                double ts = std::chrono::duration<double, std::micro>(event.start - epoch()).count();
+                double dur = std::chrono::duration<double, std::micro>(event.end - event.start).count();
+                out << (first ? "" : ",") << "\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":"
+                    << buffer->tid << ",\"ts\":" << ts << ",\"dur\":" << dur << "}";
+                first = false;
+            }
+        }
+        out << "\n]}\n";
+    }
+
+    // p50/p95/p99 in ms of the PROFILE_WINDOW spans per name that ended last, over all threads
+    inline std::map<std::string, std::vector<double>> percentiles() {
+        std::map<std::string, std::vector<Event>> spans;
+        {
+            std::lock_guard<std::mutex> lock(registryMutex());
+            for (auto const& buffer : registry()) {
+                for (const Event& event : ordered(*buffer)) {
+                    spans[event.name].push_back(event);
+                }
+            }
+        }
+        std::map<std::string, std::vector<double>> result;
+        for (auto& entry : spans) {
+            // Buffers are joined thread by thread, the window is taken in time order
+            std::vector<Event>& events = entry.second;
+            std::sort(events.begin(), events.end(), [](const Event& a, const Event& b) { return a.end < b.end; });
+            size_t first = events.size() > PROFILE_WINDOW ? events.size() - PROFILE_WINDOW : 0;
+            std::vector<double> window;
+            for (size_t i = first; i < events.size(); i++) {
+                window.push_back(std::chrono::duration<double, std::milli>(events[i].end - events[i].start).count());
+            }
+            std::sort(window.begin(), window.end());
+            auto at = [&](double p) {
+                return window[std::min(window.size() - 1, (size_t)(p / 100.0 * window.size()))];
+            };
+            result[entry.first] = { at(50), at(95), at(99) };
+        }
+        return result;
+    }
+
+    inline void printPercentiles() {
+        for (auto const& entry : percentiles()) {
+            std::cout << "[Profiler] " << entry.first << ": p50 " << entry.second[0] << " ms, p95 "
+                << entry.second[1] << " ms, p99 " << entry.second[2] << " ms" << std::endl;
+        }
+    }
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) Profiler::ScopedTimer PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_RECORD(name, start, end) Profiler::record(name, start, end)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_RECORD(name, start, end)
+
+#endif
@@ -0,0 +1,242 @@
+#include "QuadDetector.h"
+
+// C / C++
+#include <cstring>
+#include <algorithm>
+
+// OpenCV
+#include <opencv2/imgproc.hpp>
+
+int QuadDetector::find(std::vector<Run>& runs, int i) {
+	// Path halving
+	while (runs[i].parent != i) {
+		runs[i].parent = runs[runs[i].parent].parent;
+		i = runs[i].parent;
+	}
+	return i;
+}
+
+void QuadDetector::joinRows(std::vector<Run>& runs, int aBegin, int aEnd, int bBegin, int bEnd, int reach) {
+	int i = aBegin, j = bBegin;
+	while (i < aEnd && j < bEnd) {
+		if (runs[i].end + reach < runs[j].start) {
+			i++;
+		}
+		else if (runs[j].end + reach < runs[i].start) {
+			j++;
+		}
+		else {
+			// Touching (diagonally too with reach 1), the smaller index becomes the root
+			int a = find(runs, i), b = find(runs, j);
+			if (a != b) {
+				runs[std::max(a, b)].parent = std::min(a, b);
+			}
+			if (runs[i].end < runs[j].end) {
+				i++;
+			}
+			else {
+				j++;
+			}
+		}
+	}
+}
+
+void QuadDetector::scanTile(const cv::Mat& binary, int rowBegin, int rowEnd, std::vector<Run>& out) {
+	out.clear();
+	int previousBegin = 0, previousEnd = 0;
+	for (int y = rowBegin; y < rowEnd; y++) {
+		const uchar* row = binary.ptr<uchar>(y);
+		int rowStart = (int)out.size();
+		int x = 0;
+		while (x < binary.cols) {
+			// White is skipped with memchr, which is vectorized by the C library
+			const uchar* dark = (const uchar*)std::memchr(row + x, 0, binary.cols - x);
+			if (!dark) {
+				break;
+			}
+			int start = (int)(dark - row);
+			x = start + 1;
+			while (x < binary.cols && row[x] == 0) {
+				x++;
+			}
+			out.push_back({ y, start, x - 1, (int)out.size() });
+		}
+		int rowEnd = (int)out.size();
+		joinRows(out, previousBegin, previousEnd, rowStart, rowEnd, 1);
+		previousBegin = rowStart;
+		previousEnd = rowEnd;
+	}
+}
+
+// Tiles of detect, a loop body object instead of a lambda so no std::function is allocated
+class QuadDetector::ScanBody : public cv::ParallelLoopBody {
+	public:
+		ScanBody(const cv::Mat& para_binary, std::vector<std::vector<Run>>& para_tileRuns)
+			: binary(para_binary), tileRuns(para_tileRuns) {}
+
+		void operator()(const cv::Range& range) const override {
+			int tiles = (int)tileRuns.size();
+			for (int t = range.start; t < range.end; t++) {
+				scanTile(binary, binary.rows * t / tiles, binary.rows * (t + 1) / tiles, tileRuns[t]);
+			}
+		}
+
+	private:
+		const cv::Mat& binary;
+		std::vector<std::vector<Run>>& tileRuns;
+};
+
+const std::vector<quad_points_t>& QuadDetector::detect(const cv::Mat& binary, int minSide) {
+	CV_Assert(binary.type() == CV_8UC1);
+	int tiles = std::max(1, std::min(cv::getNumThreads(), binary.rows / QUAD_MIN_TILE_ROWS));
+	tileRuns.resize(tiles);
+	cv::parallel_for_(cv::Range(0, tiles), ScanBody(binary, tileRuns));
+
+	// One list with global indices, then the seams between the tiles
+	runs.clear();
+	tileStart.clear();
+	for (int t = 0; t < tiles; t++) {
+		int offset = (int)runs.size();
+		tileStart.push_back(offset);
+		for (Run run : tileRuns[t]) {
+			run.parent += offset;
+			runs.push_back(run);
+		}
+	}
+	tileStart.push_back((int)runs.size());
+	for (int t = 1; t < tiles; t++) {
+		int seam = binary.rows * t / tiles;
+		int aEnd = tileStart[t], aBegin = aEnd;
+		while (aBegin > tileStart[t - 1] && runs[aBegin - 1].y == seam - 1) {
+			aBegin--;
+		}
+		int bBegin = tileStart[t], bEnd = bBegin;
+		while (bEnd < tileStart[t + 1] && runs[bEnd].y == seam) {
+			bEnd++;
+		}
+		joinRows(runs, aBegin, aEnd, bBegin, bEnd, 1);
+	}
+
+	collectComponents(runs, componentOf, next, components);
+
+	quads.clear();
+	for (Component& component : components) {
+		// Too small, or cut by the frame border like findContours never reports as a hole
+		if (!isCandidate(component, binary, minSide)) {
+			continue;
+		}
+		quad_points_t quad;
+		double area;
+		if (!fitQuad(runs, next, component, quad, area)) {
+			continue;
+		}
+		// A border has white inside, solid blobs are dropped before refinement
+		if (component.area > QUAD_MAX_FILL * area) {
+			continue;
+		}
+		component.hasQuad = true;
+		quads.push_back(quad);
+	}
+
+	// White runs between the dark runs of every row, 4-connected like the inside of an 8-connected border
+	gaps.clear();
+	gapLeft.clear();
+	int r = 0, previousBegin = 0, previousEnd = 0;
+	for (int y = 0; y < binary.rows; y++) {
+		int rowBegin = (int)gaps.size();
+		int x = 0, left = -1;
+		for (; r < (int)runs.size() && runs[r].y == y; r++) {
+			if (runs[r].start > x) {
+				gaps.push_back({ y, x, runs[r].start - 1, (int)gaps.size() });
+				gapLeft.push_back(left);
+			}
+			x = runs[r].end + 1;
+			left = r;
+		}
+		if (x < binary.cols) {
+			gaps.push_back({ y, x, binary.cols - 1, (int)gaps.size() });
+			gapLeft.push_back(left);
+		}
+		int rowEnd = (int)gaps.size();
+		joinRows(gaps, previousBegin, previousEnd, rowBegin, rowEnd, 0);
+		previousBegin = rowBegin;
+		previousEnd = rowEnd;
+	}
+	collectComponents(gaps, holeOf, nextGap, holes);
+
+	// The white inside of a border that got no quad itself: merged with a finger, a shadow or a dark table,
+	// or cut by the frame border. findContours found these as the outline of the white area.
+	for (const Component& hole : holes) {
+		if (!isCandidate(hole, binary, minSide)) {
+			continue;
+		}
+		// Above and left of the first run of a hole is its enclosing dark component
+		const Component& enclosing = components[componentOf[find(runs, gapLeft[hole.top])]];
+		if (enclosing.hasQuad) {
+			continue;
+		}
+		quad_points_t quad;
+		double area;
+		if (fitQuad(gaps, nextGap, hole, quad, area)) {
+			quads.push_back(quad);
+		}
+	}
+	return quads;
+}
+
+void QuadDetector::collectComponents(std::vector<Run>& runs, std::vector<int>& componentOf, std::vector<int>& next,
+	std::vector<Component>& components) {
+	// Bounding box, area and the runs of every component
+	components.clear();
+	componentOf.assign(runs.size(), -1);
+	next.assign(runs.size(), -1);
+	for (int i = 0; i < (int)runs.size(); i++) {
+		int root = find(runs, i);
+		if (componentOf[root] == -1) {
+			componentOf[root] = (int)components.size();
+			components.push_back({ runs[i].start, runs[i].y, runs[i].end, runs[i].y, 0, -1, i, false });
+		}
+		Component& component = components[componentOf[root]];
+		component.minX = std::min(component.minX, runs[i].start);
+		component.maxX = std::max(component.maxX, runs[i].end);
+		component.minY = std::min(component.minY, runs[i].y);
+		component.maxY = std::max(component.maxY, runs[i].y);
+		component.area += runs[i].end - runs[i].start + 1;
+		next[i] = component.first;
+		component.first = i;
+	}
+}
+
+bool QuadDetector::isCandidate(const Component& component, const cv::Mat& binary, int minSide) {
+	if (component.maxX - component.minX + 1 < minSide || component.maxY - component.minY + 1 < minSide) {
+		return false;
+	}
+	return component.minX > 0 && component.minY > 0 && component.maxX < binary.cols - 1 && component.maxY < binary.rows - 1;
+}
+
+bool QuadDetector::fitQuad(const std::vector<Run>& runs, const std::vector<int>& next, const Component& component,
+	quad_points_t& quad, double& area) {
+	// The run ends are the outline, their hull is the marker square
+	points.clear();
+	for (int i = component.first; i != -1; i = next[i]) {
+		points.push_back(cv::Point(runs[i].start, runs[i].y));
+		points.push_back(cv::Point(runs[i].end, runs[i].y));
+	}
+	cv::convexHull(points, hull);
+	cv::approxPolyDP(hull, approx, cv::arcLength(hull, true) * 0.02, true);
+	if (approx.size() != 4) {
+		return false;
+	}
+	quad = { approx[0], approx[1], approx[2], approx[3] };
+
+	double signedArea = 0;
+	for (int i = 0; i < 4; i++) {
+		signedArea += (double)quad[i].x * quad[(i + 1) % 4].y - (double)quad[(i + 1) % 4].x * quad[i].y;
+	}
+	// y points down: a positive area is clockwise on screen
+	if (signedArea < 0) {
+		std::reverse(quad.begin(), quad.end());
+	}
+	area = std::abs(signedArea) / 2;
+	return true;
+}
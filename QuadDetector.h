@@ -0,0 +1,86 @@
+#pragma once
+
+// C / C++
+#include <array>
+#include <vector>
+
+// OpenCV
+#include <opencv2/core.hpp>
+
+typedef std::vector<cv::Point> contour_t;
+// List of contours
+typedef std::vector<contour_t> contour_vector_t;
+// Four corners, fixed size so a list of them is reused without allocating
+typedef std::array<cv::Point, 4> quad_points_t;
+
+// Rows per tile at least, thinner tiles cost more in seam merging than they save
+#define QUAD_MIN_TILE_ROWS 32
+// Dark pixels per hull area above this are solid blobs, not a marker border with white inside
+#define QUAD_MAX_FILL 0.9
+
+/* Marker candidates in one scan of the binary image
+* Dark pixels are collected as horizontal runs, runs touching in the next row (8-connected) are joined with
+* union-find into components. Only components of candidate size with a ring shape get a convex hull fitted
+* to a quad. Horizontal tiles are scanned in parallel and joined at their seams.
+* The white gaps between the runs are joined (4-connected) into holes too. A hole enclosed by a component
+* without quad, e.g. a border merged with a finger or cut by the frame, gets the quad of its white area,
+* like findContours reported it.
+*/
+class QuadDetector {
+    public:
+        /* detect
+        * @param binary : CV_8UC1, 0 is dark
+        * @param minSide : smaller components (bounding box side in pixels) are skipped
+        * @return quads clockwise on screen like the hole borders of cv::findContours, valid until the next call
+        */
+        const std::vector<quad_points_t>& detect(const cv::Mat& binary, int minSide);
+
+    private:
+        struct Run {
+            int y;
+            int start;  // First dark pixel
+            int end;    // Last dark pixel
+            int parent; // Union-find, index into runs
+        };
+
+        struct Component {
+            int minX, minY, maxX, maxY;
+            int area;
+            int first;      // Runs of a component are linked through next, -1 ends
+            int top;        // Lowest run index: top row, leftmost
+            bool hasQuad;
+        };
+
+        // Reused between frames
+        std::vector<std::vector<Run>> tileRuns;
+        std::vector<Run> runs;
+        std::vector<int> tileStart;
+        std::vector<int> next;
+        std::vector<int> componentOf;
+        std::vector<Component> components;
+        std::vector<Run> gaps;          // White runs, the holes are built from them
+        std::vector<int> gapLeft;       // Dark run left of each gap, -1 at the frame border
+        std::vector<int> nextGap;
+        std::vector<int> holeOf;
+        std::vector<Component> holes;
+        std::vector<cv::Point> points;
+        contour_t hull;
+        contour_t approx;
+        std::vector<quad_points_t> quads;
+
+        static int find(std::vector<Run>& runs, int i);
+        // Join the runs [aBegin, aEnd) of one row with the touching runs [bBegin, bEnd) of the next row,
+        // reach 1 joins diagonal neighbours (8-connected), 0 only vertical ones (4-connected)
+        static void joinRows(std::vector<Run>& runs, int aBegin, int aEnd, int bBegin, int bEnd, int reach);
+        // Runs of the rows [rowBegin, rowEnd), joined within the tile
+        static void scanTile(const cv::Mat& binary, int rowBegin, int rowEnd, std::vector<Run>& out);
+        class ScanBody;
+
+        static void collectComponents(std::vector<Run>& runs, std::vector<int>& componentOf, std::vector<int>& next,
+            std::vector<Component>& components);
+        // Of candidate size and not cut by the frame border
+        static bool isCandidate(const Component& component, const cv::Mat& binary, int minSide);
+        // Hull of the component reduced to 4 corners, clockwise on screen; area is the quad's
+        bool fitQuad(const std::vector<Run>& runs, const std::vector<int>& next, const Component& component,
+            quad_points_t& quad, double& area);
+};
@@ -0,0 +1,144 @@
+#pragma once
+
+// C / C++
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Model.h"
+
+// Uniform locations of a shader program, resolved once
+struct ProgramUniforms {
+    GLint model;
+    GLint texture;
+};
+
+// One mesh of one model instance
+struct DrawItem {
+    int layer;
+    GLuint program;
+    GLuint texture;
+    GLuint vao;
+    GLsizei indexCount;
+    GLenum indexType;
+    int instance;   // Index into the matrix list, all meshes of a model share one matrix
+};
+
+// State changes issued by the last flush
+struct RenderQueueStats {
+    int draws = 0;
+    int programBinds = 0;
+    int textureBinds = 0;
+    int vaoBinds = 0;
+    int uniformUploads = 0;
+};
+
+// Collect all model draws of a frame and submit them sorted by layer, program and texture
+// so shared state (e.g. textures from one textureMap) is bound only once
+class RenderQueue {
+    public:
+        // Queue every mesh of a model, the model's own normalization is applied on top of world
+        // world places the model in camera space, projection and view come from the Camera uniform block
+        // The handle is kept until flush, so an eviction in between can't free the buffers
+        // Higher layers are drawn later, e.g. blended text after opaque models
+        void submit(GLuint program, ModelHandle model, const glm::mat4& world, int layer = 0) {
+            int instance = (int)matrices.size();
+            matrices.push_back(world * model->transform);
+            models.push_back(model);
+            for (const Mesh& mesh : model->meshes) {
+                items.push_back({ layer, program, mesh.diffuseTexture, mesh.vao, mesh.indexCount, mesh.indexType, instance });
+            }
+        }
+
+        // Sort and draw all queued items, the queue is empty afterwards
+        void flush() {
+            std::stable_sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) {
+                if (a.layer != b.layer) return a.layer < b.layer;
+                if (a.program != b.program) return a.program < b.program;
+                if (a.texture != b.texture) return a.texture < b.texture;
+                if (a.vao != b.vao) return a.vao < b.vao;
+                return a.instance < b.instance;
+            });
+
+            stats = RenderQueueStats();
+            GLuint boundProgram = 0, boundTexture = 0, boundVao = 0;
+            int uploadedInstance = -1;
+            const ProgramUniforms* locations = NULL;
+
+            glActiveTexture(GL_TEXTURE0);
+            for (const DrawItem& item : items) {
+                if (item.program != boundProgram || locations == NULL) {
+                    glUseProgram(item.program);
+                    locations = &getUniforms(item.program);
+                    boundProgram = item.program;
+                    uploadedInstance = -1;
+                    stats.programBinds++;
+                }
+                if (item.texture != boundTexture || stats.textureBinds == 0) {
+                    glBindTexture(GL_TEXTURE_2D, item.texture);
+                    boundTexture = item.texture;
+                    stats.textureBinds++;
+                }
+                if (item.vao != boundVao) {
+                    glBindVertexArray(item.vao);
+                    boundVao = item.vao;
+                    stats.vaoBinds++;
+                }
+                // Once per run of one instance: a model with several textures is split by the sort and uploads
+                // its matrix again for every texture, texture binds cost more than a 4x4 upload
+                if (item.instance != uploadedInstance) {
+                    glUniformMatrix4fv(locations->model, 1, GL_FALSE, glm::value_ptr(matrices[item.instance]));
+                    uploadedInstance = item.instance;
+                    stats.uniformUploads++;
+                }
+                glDrawElements(GL_TRIANGLES, item.indexCount, item.indexType, 0);
+                stats.draws++;
+            }
+            glBindVertexArray(0);
+
+            items.clear();
+            matrices.clear();
+            models.clear();
+        }
+
+        // Uniform locations are looked up on first use of a program only
+        const ProgramUniforms& getUniforms(GLuint program) {
+            auto it = uniforms.find(program);
+            if (it != uniforms.end()) {
+                return it->second;
+            }
+            ProgramUniforms& locations = uniforms[program];
+            locations.model = glGetUniformLocation(program, "Model");
+            // Model programs sample diffuseTexture, text programs the glyphAtlas
+            locations.texture = glGetUniformLocation(program, "diffuseTexture");
+            if (locations.texture < 0) {
+                locations.texture = glGetUniformLocation(program, "glyphAtlas");
+            }
+
+            // Sampler always reads texture unit 0, the value is part of the program state
+            glUseProgram(program);
+            if (locations.texture >= 0) {
+                glUniform1i(locations.texture, 0);
+            }
+            return locations;
+        }
+
+        const RenderQueueStats& getStats() {
+            return stats;
+        }
+
+    private:
+        std::vector<DrawItem> items;
+        std::vector<glm::mat4> matrices;
+        std::vector<ModelHandle> models;
+        std::map<GLuint, ProgramUniforms> uniforms;
+        RenderQueueStats stats;
+};
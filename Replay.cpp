@@ -0,0 +1,419 @@
+// Count every operator new of this process, see AllocationCounter.h
+#define ALLOCATION_COUNTER_HOOK
+#include "AllocationCounter.h"
+
+#include "Util.h"
+#include "Tracker.h"
+#include "MetaManager.h"
+#include "FrameSource.h"
+
+// C / C++
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+// Allowed change against the baseline before a run counts as regression
+#define REGRESSION_FPS_DROP 0.10            // Relative
+#define REGRESSION_LATENCY_RISE 0.10        // Relative, p95 of a whole frame
+#define REGRESSION_RATE_DROP 0.01           // Absolute, recall and precision
+#define REGRESSION_CORNER_RISE 0.25         // Pixels, mean corner error
+#define REGRESSION_ALLOCATION_RISE 0.5      // Absolute, mean heap allocations of one track call
+
+// Frames before allocations are counted, buffers grow to their steady size here
+#define REPLAY_WARMUP_FRAMES 10
+
+/* Replay harness
+* Feeds a recorded video or image sequence through tracking, pose estimation and combination matching
+* and compares the detections with a ground truth sidecar:
+* { "frames": [ { "frame": 0, "markers": [ { "id": 1, "corners": [[x, y], [x, y], [x, y], [x, y]] } ] } ] }
+* Frames without entry have no markers, markers with id -1 are distractors the tracker shouldn't know.
+* Corners are in pixels of the input, which may have another size than the calibration the frames are resized to.
+* Everything runs on one thread with fixed inputs, so runs are repeatable.
+* After REPLAY_WARMUP_FRAMES, heap allocations inside Tracker::track are counted (OCR excluded), steady state should have none.
+*
+* ARKanjiReplay --input <video|pattern|dir> --truth <gt.json> [--threshold n] [--report out.json] [--baseline base.json]
+*               [--trace trace.json]  (needs ARKANJI_PROFILE) [--table] [--calibration file.yml] [--pyramid n] [--contours]
+*               [--no-ocr-cache] [--batched-ocr] [--yuv auto|i420|nv12] [--compare contours|batched-ocr]
+* --compare tracks every frame a second time with the candidate detection or the OCR mode switched and reports
+* recall and precision of both, a lower recall of the configured path counts as regression.
+*/
+
+// Stage timings of every frame, the last two stages are outside of Tracker::track
+#define REPLAY_STAGE_COUNT (STAGE_COUNT + 2)
+static const char* const REPLAY_STAGE_NAMES[REPLAY_STAGE_COUNT] = {
+    "preprocess", "contours", "refine", "normalize", "ocr", "pose", "combination", "frame"
+};
+
+struct ReplayOptions {
+    std::string input;
+    std::string truth;
+    std::string report;
+    std::string baseline;
+    std::string trace;
+    std::string calibration;
+    bool table = false;
+    bool contours = false;      // Old findContours candidates, to compare against the QuadDetector
+    bool ocrCache = true;       // Off to compare recall and OCR time without the OcrCache
+    bool batchedOcr = false;    // One Tesseract call per frame, see Tracker::setBatchedOcr
+    std::string compare;        // contours or batched-ocr: a second tracker with that option switched
+    bool yuv = false;           // Raw YUV input, the tracker gets the Y plane like the main app with --yuv
+    YuvLayout yuvLayout = YUV_BY_EXTENSION;
+    int pyramidLevels = 0;
+    int threshold = 100;
+};
+
+ReplayOptions parseReplayOptions(int argc, char** argv) {
+    ReplayOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--table") {
+            options.table = true;
+            continue;
+        }
+        if (arg == "--contours") {
+            options.contours = true;
+            continue;
+        }
+        if (arg == "--no-ocr-cache") {
+            options.ocrCache = false;
+            continue;
+        }
+        if (arg == "--batched-ocr") {
+            options.batchedOcr = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        std::string value = argv[++i];
+        if (arg == "--input") options.input = value;
+        else if (arg == "--truth") options.truth = value;
+        else if (arg == "--report") options.report = value;
+        else if (arg == "--baseline") options.baseline = value;
+        else if (arg == "--trace") options.trace = value;
+        else if (arg == "--threshold") options.threshold = std::stoi(value);
+        else if (arg == "--calibration") options.calibration = value;
+        else if (arg == "--pyramid") options.pyramidLevels = std::stoi(value);
+        else if (arg == "--compare") {
+            if (value != "contours" && value != "batched-ocr") {
+                throw std::invalid_argument("--compare takes contours or batched-ocr");
+            }
+            options.compare = value;
+        }
+        else if (arg == "--yuv") {
+            options.yuv = true;
+            options.yuvLayout = parseYuvLayout(value);
+        }
+        else throw std::invalid_argument("Unknown option " + arg);
+    }
+    if (options.input.empty() || options.truth.empty()) {
+        throw std::invalid_argument("Usage: ARKanjiReplay --input <video|pattern|dir> --truth <gt.json> [--threshold n] [--report out.json] [--baseline base.json] [--trace trace.json] [--table] [--calibration file.yml] [--pyramid n] [--contours] [--no-ocr-cache] [--batched-ocr] [--yuv auto|i420|nv12] [--compare contours|batched-ocr]");
+    }
+    return options;
+}
+
+// Nearest rank percentile
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t rank = (size_t)std::ceil(p / 100.0 * values.size());
+    return values[std::min(values.size(), std::max<size_t>(rank, 1)) - 1];
+}
+
+// Mean distance of two corner quads, the start corner of a detection is arbitrary
+double cornerError(const std::vector<cv::Point2f>& detected, const std::vector<cv::Point2f>& truth) {
+    double best = std::numeric_limits<double>::max();
+    for (int shift = 0; shift < 4; shift++) {
+        double sum = 0;
+        for (int i = 0; i < 4; i++) {
+            sum += cv::norm(detected[(i + shift) % 4] - truth[i]);
+        }
+        best = std::min(best, sum / 4);
+    }
+    return best;
+}
+
+// Expected marker of a frame, an id may occur several times
+struct TruthMarker {
+    int id;
+    std::vector<cv::Point2f> corners;
+};
+
+// Ground truth markers per frame
+std::map<int, std::vector<TruthMarker>> readTruth(std::string path) {
+    std::ifstream file(path, std::ifstream::binary);
+    if (!file.is_open()) {
+        throw std::invalid_argument("Cannot read " + path);
+    }
+    Json::Value json;
+    file >> json;
+
+    std::map<int, std::vector<TruthMarker>> truth;
+    for (const Json::Value& frame : json["frames"]) {
+        auto& markers = truth[frame["frame"].asInt()];
+        for (const Json::Value& marker : frame["markers"]) {
+            std::vector<cv::Point2f> corners;
+            for (const Json::Value& corner : marker["corners"]) {
+                corners.push_back(cv::Point2f(corner[0].asFloat(), corner[1].asFloat()));
+            }
+            if (corners.size() != 4) {
+                throw std::invalid_argument("Marker in frame " + frame["frame"].asString() + " needs 4 corners");
+            }
+            if (marker["id"].asInt() >= 0) {
+                markers.push_back({ marker["id"].asInt(), corners });
+            }
+        }
+    }
+    return truth;
+}
+
+// Detections of a tracker summed over the frames
+struct DetectionScore {
+    int truePositives = 0;
+    int detections = 0;
+    double cornerErrorSum = 0;
+
+    // A detection is correct when its id is in the truth of the frame, the closest marker of that id is taken
+    void add(Tracker& tracker, const std::vector<TruthMarker>& expected, cv::Point2f scale) {
+        for (auto const& detected : tracker.getDetectedMarkerCorners()) {
+            detections++;
+            double best = std::numeric_limits<double>::max();
+            for (const TruthMarker& marker : expected) {
+                if (marker.id != detected.first) {
+                    continue;
+                }
+                std::vector<cv::Point2f> corners = marker.corners;
+                for (cv::Point2f& corner : corners) {
+                    corner = cv::Point2f(corner.x * scale.x, corner.y * scale.y);
+                }
+                best = std::min(best, cornerError(detected.second, corners));
+            }
+            if (best < std::numeric_limits<double>::max()) {
+                truePositives++;
+                cornerErrorSum += best;
+            }
+        }
+    }
+
+    void write(Json::Value& report, int truthMarkers) const {
+        report["recall"] = truthMarkers > 0 ? (double)truePositives / truthMarkers : 1.0;
+        report["precision"] = detections > 0 ? (double)truePositives / detections : 1.0;
+        report["cornerErrorPx"] = truePositives > 0 ? cornerErrorSum / truePositives : 0.0;
+    }
+};
+
+// Regression messages against a stored report, empty when the run is as good as the baseline
+std::vector<std::string> compareBaseline(const Json::Value& report, const Json::Value& baseline) {
+    std::vector<std::string> regressions;
+    auto check = [&](bool regressed, std::string what, double now, double before) {
+        if (regressed) {
+            std::ostringstream message;
+            message << what << ": " << before << " -> " << now;
+            regressions.push_back(message.str());
+        }
+    };
+    double fps = report["fps"].asDouble(), baseFps = baseline["fps"].asDouble();
+    check(fps < baseFps * (1 - REGRESSION_FPS_DROP), "fps", fps, baseFps);
+    double p95 = report["latency"]["frame"]["p95"].asDouble(), baseP95 = baseline["latency"]["frame"]["p95"].asDouble();
+    check(p95 > baseP95 * (1 + REGRESSION_LATENCY_RISE), "frame p95 ms", p95, baseP95);
+    double recall = report["recall"].asDouble(), baseRecall = baseline["recall"].asDouble();
+    check(recall < baseRecall - REGRESSION_RATE_DROP, "recall", recall, baseRecall);
+    double precision = report["precision"].asDouble(), basePrecision = baseline["precision"].asDouble();
+    check(precision < basePrecision - REGRESSION_RATE_DROP, "precision", precision, basePrecision);
+    double corner = report["cornerErrorPx"].asDouble(), baseCorner = baseline["cornerErrorPx"].asDouble();
+    check(corner > baseCorner + REGRESSION_CORNER_RISE, "corner error px", corner, baseCorner);
+    double allocations = report["allocationsPerFrame"]["mean"].asDouble();
+    double baseAllocations = baseline["allocationsPerFrame"]["mean"].asDouble();
+    check(allocations > baseAllocations + REGRESSION_ALLOCATION_RISE, "allocations per frame", allocations, baseAllocations);
+    return regressions;
+}
+
+int main(int argc, char** argv)
+{
+    ReplayOptions options = parseReplayOptions(argc, argv);
+
+    std::ifstream metaJson(META_JSON_PATH, std::ifstream::binary);
+    Json::Value meta;
+    metaJson >> meta;
+    MetaManager metaManager = MetaManager(meta);
+
+    tesseract::TessBaseAPI* api = initTesseract(metaManager.getWhitelist());
+
+    Tracker tracker = Tracker(api, meta["monji"]);
+    tracker.setDebugWindows(false);
+    tracker.setTablePlane(options.table);
+    CameraIntrinsics intrinsics = options.calibration.empty() ? CameraIntrinsics() : loadCalibration(options.calibration);
+    tracker.setIntrinsics(intrinsics);
+    tracker.setPyramidLevels(options.pyramidLevels);
+    tracker.setQuadDetector(!options.contours);
+    tracker.setOcrCache(options.ocrCache);
+    tracker.setBatchedOcr(options.batchedOcr);
+
+    // Same setup with one option switched, shares Tesseract since everything runs on this thread
+    Tracker reference = Tracker(api, meta["monji"]);
+    if (!options.compare.empty()) {
+        reference.setDebugWindows(false);
+        reference.setTablePlane(options.table);
+        reference.setIntrinsics(intrinsics);
+        reference.setPyramidLevels(options.pyramidLevels);
+        reference.setQuadDetector(options.compare == "contours" ? options.contours : !options.contours);
+        reference.setOcrCache(options.ocrCache);
+        reference.setBatchedOcr(options.compare == "batched-ocr" ? !options.batchedOcr : options.batchedOcr);
+    }
+
+    auto truth = readTruth(options.truth);
+    FrameSource source(options.input, intrinsics.width, intrinsics.height, options.yuv ? FRAME_NV12 : FRAME_BGR, options.yuvLayout);
+
+    std::vector<double> stageMs[REPLAY_STAGE_COUNT];
+    DetectionScore score, referenceScore;
+    int truthMarkers = 0;
+    double totalMs = 0;
+    long long ocrCalls = 0, ocrMarkers = 0;
+    long long allocations = 0, maxAllocations = 0;
+    int frameIndex = 0;
+
+    cv::Mat frame;
+    while (source.read(frame)) {
+        bool counted = frameIndex >= REPLAY_WARMUP_FRAMES;
+        if (counted) {
+            AllocationCounter::start();
+        }
+        auto start = std::chrono::steady_clock::now();
+        tracker.track(options.yuv ? FrameSource::luminance(frame) : frame, options.threshold);
+        auto tracked = std::chrono::steady_clock::now();
+        if (counted) {
+            long long frameAllocations = AllocationCounter::stop();
+            allocations += frameAllocations;
+            maxAllocations = std::max(maxAllocations, frameAllocations);
+        }
+        std::vector<MonjiPair> pairs = metaManager.pairMonjis(tracker.getDetectedMarkerCenter());
+        auto end = std::chrono::steady_clock::now();
+        PROFILE_RECORD("combination", tracked, end);
+        PROFILE_RECORD("frame", start, end);
+
+        const TrackTimings& timings = tracker.getLastTimings();
+        for (int stage = 0; stage < STAGE_COUNT; stage++) {
+            stageMs[stage].push_back(timings.ms[stage]);
+        }
+        ocrCalls += timings.ocrCalls;
+        ocrMarkers += timings.ocrMarkers;
+        double frameMs = std::chrono::duration<double, std::milli>(end - start).count();
+        stageMs[STAGE_COUNT].push_back(std::chrono::duration<double, std::milli>(end - tracked).count());
+        stageMs[STAGE_COUNT + 1].push_back(frameMs);
+        totalMs += frameMs;
+
+        std::vector<TruthMarker>& expected = truth[frameIndex];
+        cv::Size sourceSize = source.getSourceSize();
+        cv::Point2f scale((float)intrinsics.width / sourceSize.width, (float)intrinsics.height / sourceSize.height);
+        truthMarkers += (int)expected.size();
+        score.add(tracker, expected, scale);
+        if (!options.compare.empty()) {
+            reference.track(options.yuv ? FrameSource::luminance(frame) : frame, options.threshold);
+            referenceScore.add(reference, expected, scale);
+            reference.cleanDetectedMarkers();
+        }
+
+        tracker.cleanDetectedMarkers();
+        frameIndex++;
+    }
+
+    Json::Value report;
+    report["frames"] = frameIndex;
+    report["fps"] = totalMs > 0 ? frameIndex / (totalMs / 1000.0) : 0.0;
+    score.write(report, truthMarkers);
+    if (!options.compare.empty()) {
+        report["compare"]["option"] = options.compare;
+        referenceScore.write(report["compare"], truthMarkers);
+    }
+    int countedFrames = std::max(0, frameIndex - REPLAY_WARMUP_FRAMES);
+    report["allocationsPerFrame"]["mean"] = countedFrames > 0 ? (double)allocations / countedFrames : 0.0;
+    report["allocationsPerFrame"]["max"] = (Json::Int64)maxAllocations;
+    const OcrCacheStats& ocrStats = tracker.getOcrCacheStats();
+    report["ocrCache"]["hitRate"] = ocrStats.hitRate();
+    report["ocrCache"]["hits"] = (Json::Int64)ocrStats.hits;
+    report["ocrCache"]["misses"] = (Json::Int64)ocrStats.misses;
+    report["ocrCache"]["savedMs"] = ocrStats.savedMs;
+    double ocrMs = 0;
+    for (double ms : stageMs[STAGE_OCR]) {
+        ocrMs += ms;
+    }
+    report["ocr"]["calls"] = (Json::Int64)ocrCalls;
+    report["ocr"]["markers"] = (Json::Int64)ocrMarkers;
+    report["ocr"]["msPerMarker"] = ocrMarkers > 0 ? ocrMs / ocrMarkers : 0.0;
+    for (int stage = 0; stage < REPLAY_STAGE_COUNT; stage++) {
+        Json::Value& latency = report["latency"][REPLAY_STAGE_NAMES[stage]];
+        latency["p50"] = percentile(stageMs[stage], 50);
+        latency["p95"] = percentile(stageMs[stage], 95);
+        latency["p99"] = percentile(stageMs[stage], 99);
+    }
+
+    std::cout << std::fixed << std::setprecision(3);
+    std::cout << "[Replay] " << frameIndex << " frames, " << report["fps"].asDouble() << " fps" << std::endl;
+    std::cout << "[Replay] recall " << report["recall"].asDouble() << ", precision " << report["precision"].asDouble()
+        << ", corner error " << report["cornerErrorPx"].asDouble() << " px" << std::endl;
+    if (!options.compare.empty()) {
+        const Json::Value& compared = report["compare"];
+        std::cout << "[Replay] with " << options.compare << " switched: recall " << compared["recall"].asDouble()
+            << ", precision " << compared["precision"].asDouble() << ", corner error " << compared["cornerErrorPx"].asDouble()
+            << " px" << std::endl;
+    }
+    std::cout << "[Replay] allocations per frame: mean " << report["allocationsPerFrame"]["mean"].asDouble()
+        << ", max " << maxAllocations << " (after " << REPLAY_WARMUP_FRAMES << " warm-up frames)" << std::endl;
+    std::cout << "[Replay] OCR: " << ocrMarkers << " markers in " << ocrCalls << " Tesseract calls, "
+        << report["ocr"]["msPerMarker"].asDouble() << " ms per marker" << std::endl;
+    std::cout << "[Replay] OCR cache: hit rate " << ocrStats.hitRate() << " (" << ocrStats.hits << " hits, "
+        << ocrStats.misses << " misses), saved " << ocrStats.savedMs << " ms of recognition" << std::endl;
+    for (int stage = 0; stage < REPLAY_STAGE_COUNT; stage++) {
+        const Json::Value& latency = report["latency"][REPLAY_STAGE_NAMES[stage]];
+        std::cout << "[Replay] " << std::setw(12) << REPLAY_STAGE_NAMES[stage] << "  p50 " << latency["p50"].asDouble()
+            << " ms  p95 " << latency["p95"].asDouble() << " ms  p99 " << latency["p99"].asDouble() << " ms" << std::endl;
+    }
+
+    if (!options.report.empty()) {
+        std::ofstream out(options.report);
+        out << report;
+    }
+#ifdef ARKANJI_PROFILE
+    if (!options.trace.empty()) {
+        Profiler::writeChromeTrace(options.trace);
+    }
+#endif
+
+    // Exit code 1 signals a regression to CI
+    int exitCode = 0;
+    if (!options.baseline.empty()) {
+        std::ifstream baselineJson(options.baseline, std::ifstream::binary);
+        if (!baselineJson.is_open()) {
+            throw std::invalid_argument("Cannot read " + options.baseline);
+        }
+        Json::Value baseline;
+        baselineJson >> baseline;
+        std::vector<std::string> regressions = compareBaseline(report, baseline);
+        for (const std::string& regression : regressions) {
+            std::cout << "[Replay] REGRESSION " << regression << std::endl;
+        }
+        if (!regressions.empty()) {
+            exitCode = 1;
+        }
+        else {
+            std::cout << "[Replay] No regression against " << options.baseline << std::endl;
+        }
+    }
+    if (!options.compare.empty()) {
+        double recall = report["recall"].asDouble(), referenceRecall = report["compare"]["recall"].asDouble();
+        if (recall < referenceRecall - REGRESSION_RATE_DROP) {
+            std::cout << "[Replay] REGRESSION recall against " << options.compare << " switched: " << referenceRecall
+                << " -> " << recall << std::endl;
+            exitCode = 1;
+        }
+    }
+
+    api->End();
+    delete api;
+    return exitCode;
+}
@@ -0,0 +1,293 @@
+#pragma once
+
+// C / C++
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <iostream>
+
+// OpenGL
+#include <GL/glew.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+// FreeType
+#include <ft2build.h>
+#include FT_FREETYPE_H
+
+// OpenCV
+#include <opencv2/opencv.hpp>
+
+#include "Model.h"
+
+// Pixels per em the glyphs are rasterized with before the distance field is computed
+#define SDF_RASTER_SIZE 128
+// Pixels per em in the atlas
+#define SDF_GLYPH_SIZE 32
+// Distance in atlas pixels covered by the field on each side of an outline
+#define SDF_SPREAD 4
+#define SDF_ATLAS_WIDTH 1024
+
+// Decode a u8 string into unicode code points
+inline std::vector<uint32_t> decodeUtf8(const std::string& text) {
+    std::vector<uint32_t> codepoints;
+    for (size_t i = 0; i < text.size();) {
+        unsigned char c = text[i];
+        uint32_t cp;
+        int length;
+        if (c < 0x80) { cp = c; length = 1; }
+        else if ((c >> 5) == 0x6) { cp = c & 0x1F; length = 2; }
+        else if ((c >> 4) == 0xE) { cp = c & 0x0F; length = 3; }
+        else { cp = c & 0x07; length = 4; }
+        for (int k = 1; k < length && i + k < text.size(); k++) {
+            cp = (cp << 6) | (text[i + k] & 0x3F);
+        }
+        codepoints.push_back(cp);
+        i += length;
+    }
+    return codepoints;
+}
+
+// Unicode code point to UTF-8
+inline std::string encodeUtf8(uint32_t cp) {
+    std::string text;
+    if (cp < 0x80) {
+        text += (char)cp;
+    }
+    else if (cp < 0x800) {
+        text += (char)(0xC0 | (cp >> 6));
+        text += (char)(0x80 | (cp & 0x3F));
+    }
+    else if (cp < 0x10000) {
+        text += (char)(0xE0 | (cp >> 12));
+        text += (char)(0x80 | ((cp >> 6) & 0x3F));
+        text += (char)(0x80 | (cp & 0x3F));
+    }
+    else {
+        text += (char)(0xF0 | (cp >> 18));
+        text += (char)(0x80 | ((cp >> 12) & 0x3F));
+        text += (char)(0x80 | ((cp >> 6) & 0x3F));
+        text += (char)(0x80 | (cp & 0x3F));
+    }
+    return text;
+}
+
+// Signed distance field glyph atlas for the few glyphs used by the labels
+// Labels are rendered as textured quads, the shader reconstructs sharp outlines at any distance
+class SdfFont {
+    public:
+        /* SdfFont
+        * Rasterize all glyphs used in texts into an atlas and upload it
+        * @param fontPath : path to the font file
+        * @param texts : u8 strings which will be rendered
+        * @param para_faceSize : em size in label units, like FTFont::FaceSize
+        */
+        SdfFont(std::string fontPath, const std::vector<std::string>& texts, float para_faceSize) {
+            faceSize = para_faceSize;
+            auto start = std::chrono::steady_clock::now();
+
+            FT_Library library;
+            FT_Face face;
+            if (FT_Init_FreeType(&library) || FT_New_Face(library, fontPath.c_str(), 0, &face)) {
+                throw std::invalid_argument("No such font file!");
+            }
+            FT_Set_Pixel_Sizes(face, 0, SDF_RASTER_SIZE);
+
+            std::set<uint32_t> codepoints;
+            for (const std::string& text : texts) {
+                for (uint32_t cp : decodeUtf8(text)) {
+                    codepoints.insert(cp);
+                }
+            }
+
+            // Shelf packing of the glyph fields
+            cv::Mat atlas(SDF_ATLAS_WIDTH, SDF_ATLAS_WIDTH, CV_8UC1, cv::Scalar(0));
+            int x = 0, y = 0, shelfHeight = 0;
+            int downscale = SDF_RASTER_SIZE / SDF_GLYPH_SIZE;
+            int padding = SDF_SPREAD * downscale;
+
+            for (uint32_t cp : codepoints) {
+                if (FT_Load_Char(face, cp, FT_LOAD_RENDER)) {
+                    continue;
+                }
+                FT_GlyphSlot slot = face->glyph;
+                Glyph glyph;
+                glyph.advance = (slot->advance.x / 64.f) / SDF_RASTER_SIZE;
+
+                if (slot->bitmap.width > 0 && slot->bitmap.rows > 0) {
+                    cv::Mat field = computeField(slot->bitmap, padding, downscale);
+                    if (x + field.cols > SDF_ATLAS_WIDTH) {
+                        x = 0;
+                        y += shelfHeight;
+                        shelfHeight = 0;
+                    }
+                    if (y + field.rows > SDF_ATLAS_WIDTH) {
+                        std::cout << "[SdfFont] Atlas is full, glyph " << cp << " skipped" << std::endl;
+                        continue;
+                    }
+                    field.copyTo(atlas(cv::Rect(x, y, field.cols, field.rows)));
+
+                    glyph.uvMin = glm::vec2((float)x / SDF_ATLAS_WIDTH, (float)y / SDF_ATLAS_WIDTH);
+                    glyph.uvMax = glm::vec2((float)(x + field.cols) / SDF_ATLAS_WIDTH, (float)(y + field.rows) / SDF_ATLAS_WIDTH);
+                    glyph.quadMin = glm::vec2((float)(slot->bitmap_left - padding) / SDF_RASTER_SIZE,
+                        (float)(slot->bitmap_top - (int)slot->bitmap.rows - padding) / SDF_RASTER_SIZE);
+                    glyph.quadMax = glyph.quadMin + glm::vec2((float)field.cols * downscale / SDF_RASTER_SIZE,
+                        (float)field.rows * downscale / SDF_RASTER_SIZE);
+                    glyph.visible = true;
+
+                    x += field.cols;
+                    shelfHeight = std::max(shelfHeight, field.rows);
+                }
+                glyphs[cp] = glyph;
+            }
+
+            FT_Done_Face(face);
+            FT_Done_FreeType(library);
+
+            // Only the used rows of the atlas are uploaded
+            atlasHeight = std::max(1, y + shelfHeight);
+            glGenTextures(1, &texture);
+            glBindTexture(GL_TEXTURE_2D, texture);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, SDF_ATLAS_WIDTH, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, atlas.data);
+
+            // Texture coordinates were computed for the full square atlas
+            float vScale = (float)SDF_ATLAS_WIDTH / atlasHeight;
+            for (auto& glyph : glyphs) {
+                glyph.second.uvMin.y *= vScale;
+                glyph.second.uvMax.y *= vScale;
+            }
+
+            buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "[SdfFont] " << glyphs.size() << " glyphs, atlas " << SDF_ATLAS_WIDTH << "x" << atlasHeight
+                << " built in " << buildMs << " ms" << std::endl;
+        }
+
+        ~SdfFont() {
+            release();
+        }
+
+        // Delete the atlas, must be called while the GL context is still alive
+        void release() {
+            if (texture) {
+                glDeleteTextures(1, &texture);
+                texture = 0;
+            }
+        }
+
+        SdfFont(const SdfFont&) = delete;
+        SdfFont& operator=(const SdfFont&) = delete;
+
+        // One textured quad per glyph, drawn with the sdf shader
+        ModelHandle buildLabel(const std::string& text, glm::vec3 color) {
+            struct SdfVertex {
+                glm::vec3 position;
+                glm::vec2 texcoord;
+                glm::vec3 color;
+            };
+            std::vector<SdfVertex> vertices;
+            std::vector<uint16_t> index;
+
+            float pen = 0;
+            for (uint32_t cp : decodeUtf8(text)) {
+                auto it = glyphs.find(cp);
+                if (it == glyphs.end()) {
+                    continue;
+                }
+                const Glyph& glyph = it->second;
+                if (glyph.visible) {
+                    glm::vec2 lo = (glyph.quadMin + glm::vec2(pen, 0.f)) * faceSize;
+                    glm::vec2 hi = (glyph.quadMax + glm::vec2(pen, 0.f)) * faceSize;
+                    uint16_t first = (uint16_t)vertices.size();
+                    // Atlas rows go top down, glyph quads bottom up
+                    vertices.push_back({ glm::vec3(lo.x, lo.y, 0.f), glm::vec2(glyph.uvMin.x, glyph.uvMax.y), color });
+                    vertices.push_back({ glm::vec3(hi.x, lo.y, 0.f), glm::vec2(glyph.uvMax.x, glyph.uvMax.y), color });
+                    vertices.push_back({ glm::vec3(hi.x, hi.y, 0.f), glm::vec2(glyph.uvMax.x, glyph.uvMin.y), color });
+                    vertices.push_back({ glm::vec3(lo.x, hi.y, 0.f), glm::vec2(glyph.uvMin.x, glyph.uvMin.y), color });
+                    uint16_t quad[6] = { first, (uint16_t)(first + 1), (uint16_t)(first + 2), first, (uint16_t)(first + 2), (uint16_t)(first + 3) };
+                    index.insert(index.end(), quad, quad + 6);
+                }
+                pen += glyph.advance;
+            }
+
+            std::shared_ptr<Model> label = std::make_shared<Model>();
+            label->meshes.push_back(Mesh());
+            Mesh& mesh = label->meshes.back();
+            mesh.diffuseTexture = texture;
+
+            glGenVertexArrays(1, &mesh.vao);
+            glBindVertexArray(mesh.vao);
+            glGenBuffers(1, &mesh.vbo);
+            glBindBuffer(GL_ARRAY_BUFFER, mesh.vbo);
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(SdfVertex), vertices.data(), GL_STATIC_DRAW);
+            glEnableVertexAttribArray(0);   // In shader (layout = 0) represents vertex pos
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(SdfVertex), (GLvoid*)offsetof(SdfVertex, position));
+            glEnableVertexAttribArray(1);   // In shader (layout = 1) represents atlas coords
+            glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(SdfVertex), (GLvoid*)offsetof(SdfVertex, texcoord));
+            glEnableVertexAttribArray(2);   // In shader (layout = 2) represents text color
+            glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(SdfVertex), (GLvoid*)offsetof(SdfVertex, color));
+            glGenBuffers(1, &mesh.ebo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.ebo);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, index.size() * sizeof(uint16_t), index.data(), GL_STATIC_DRAW);
+            glBindVertexArray(0);
+
+            mesh.indexCount = (GLsizei)index.size();
+            mesh.indexType = GL_UNSIGNED_SHORT;
+            mesh.gpuBytes = vertices.size() * sizeof(SdfVertex) + index.size() * sizeof(uint16_t);
+            return label;
+        }
+
+        double getBuildMs() {
+            return buildMs;
+        }
+
+    private:
+        struct Glyph {
+            glm::vec2 uvMin, uvMax;         // Rect in the atlas
+            glm::vec2 quadMin, quadMax;     // Rect relative to the pen position, in em
+            float advance = 0;              // In em
+            bool visible = false;           // Space has no outline
+        };
+
+        std::map<uint32_t, Glyph> glyphs;
+        GLuint texture = 0;
+        int atlasHeight = 0;
+        float faceSize;
+        double buildMs = 0;
+
+        // Distance field of a high resolution coverage bitmap, downsampled into atlas resolution
+        // 0.5 is on the outline, above is inside
+        cv::Mat computeField(const FT_Bitmap& bitmap, int padding, int downscale) {
+            cv::Mat coverage((int)bitmap.rows, (int)bitmap.width, CV_8UC1, bitmap.buffer, bitmap.pitch);
+
+            // Padded so the field can fall off outside the outline, rounded up to the downscale factor
+            int cols = ((int)bitmap.width + 2 * padding + downscale - 1) / downscale * downscale;
+            int rows = ((int)bitmap.rows + 2 * padding + downscale - 1) / downscale * downscale;
+            cv::Mat inside(rows, cols, CV_8UC1, cv::Scalar(0));
+            cv::Mat mask;
+            cv::threshold(coverage, mask, 127, 255, cv::THRESH_BINARY);
+            mask.copyTo(inside(cv::Rect(padding, padding, coverage.cols, coverage.rows)));
+            cv::Mat outside = 255 - inside;
+
+            // Distance of every pixel to the nearest pixel on the other side of the outline
+            cv::Mat distInside, distOutside;
+            cv::distanceTransform(inside, distInside, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+            cv::distanceTransform(outside, distOutside, cv::DIST_L2, cv::DIST_MASK_PRECISE);
+            cv::Mat field = (distInside - distOutside) / (2.f * padding) + 0.5f;
+
+            cv::Mat small;
+            cv::resize(field, small, cv::Size(cols / downscale, rows / downscale), 0, 0, cv::INTER_AREA);
+            cv::Mat result;
+            small.convertTo(result, CV_8UC1, 255.0);
+            return result;
+        }
+};
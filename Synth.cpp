@@ -0,0 +1,315 @@
+#include "Util.h"
+#include "MetaManager.h"
+#include "SdfText.h"
+
+// C / C++
+#include <iomanip>
+#include <sstream>
+
+// OpenCV, portable directory creation without C++17
+#include <opencv2/core/utils/filesystem.hpp>
+
+// Focal length at 640 px width, the default camera of the tracker; it grows with --width so the field of view stays the same
+#define SYNTH_FOCAL_LENGTH DEFAULT_FOCAL_LENGTH
+#define SYNTH_MARKER_SIZE 0.041
+// White paper around the black marker border, relative to the marker size
+#define SYNTH_CARD_MARGIN 0.2
+// Glyph markers are drawn like the printed ones: 100x100, black border and a black bottom left corner
+#define SYNTH_GLYPH_MARKER_SIZE 100
+#define SYNTH_PLACEMENT_TRIES 50
+
+/* Synthetic scene generator
+* Places marker cards under random 3D poses into frames, adds lighting gradients, motion blur and noise
+* and writes the frames with exact ground truth in the format of ARKanjiReplay:
+* <output>/frame_000000.png ... and <output>/truth.json, plus <output>/calibration.yml for --calibration
+* { "width", "height", "focalLength", "markerSize", "seed",
+*   "frames": [ { "frame": 0, "markers": [ { "id": 1, "kanji": "火", "corners": [[x, y] x4], "pose": [16] } ] } ] }
+* Corners start top left of the upright marker and go clockwise, the pose is row-major like estimateSquarePose
+* (camera looks down -z, y up). Glyph markers of kanjis outside the lexicon have id -1 and act as distractors.
+*
+* ARKanjiSynth --output <dir> [--frames n] [--markers n] [--width w] [--height h] [--seed s]
+*              [--min-size px] [--max-size px] [--max-tilt deg] [--blur px] [--noise sigma] [--glyphs <kanjis>]
+*/
+
+struct SynthOptions {
+    std::string output;
+    int frames = 100;
+    int markers = 6;
+    int width = DEFAULT_FRAME_WIDTH;
+    int height = DEFAULT_FRAME_HEIGHT;
+    int seed = 1;
+    double minSize = 40;        // Marker edge in pixels when facing the camera
+    double maxSize = 160;
+    double maxTilt = 60;        // Degrees between marker normal and view axis
+    double blur = 0;            // Longest motion blur in pixels
+    double noise = 0;           // Sigma of the gaussian sensor noise
+    std::string glyphs = "";    // Extra kanjis rendered from the font
+};
+
+SynthOptions parseSynthOptions(int argc, char** argv) {
+    SynthOptions options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (i + 1 >= argc) {
+            throw std::invalid_argument("Missing value for " + arg);
+        }
+        std::string value = argv[++i];
+        if (arg == "--output") options.output = value;
+        else if (arg == "--frames") options.frames = std::stoi(value);
+        else if (arg == "--markers") options.markers = std::stoi(value);
+        else if (arg == "--width") options.width = std::stoi(value);
+        else if (arg == "--height") options.height = std::stoi(value);
+        else if (arg == "--seed") options.seed = std::stoi(value);
+        else if (arg == "--min-size") options.minSize = std::stod(value);
+        else if (arg == "--max-size") options.maxSize = std::stod(value);
+        else if (arg == "--max-tilt") options.maxTilt = std::stod(value);
+        else if (arg == "--blur") options.blur = std::stod(value);
+        else if (arg == "--noise") options.noise = std::stod(value);
+        else if (arg == "--glyphs") options.glyphs = value;
+        else throw std::invalid_argument("Unknown option " + arg);
+    }
+    if (options.output.empty()) {
+        throw std::invalid_argument("Usage: ARKanjiSynth --output <dir> [--frames n] [--markers n] [--width w] [--height h] [--seed s] "
+            "[--min-size px] [--max-size px] [--max-tilt deg] [--blur px] [--noise sigma] [--glyphs <kanjis>]");
+    }
+    return options;
+}
+
+// One marker design with the lexicon id it should be recognized as
+struct MarkerTemplate {
+    int id;
+    std::string kanji;
+    cv::Mat card;   // Gray marker with white margin
+};
+
+// Printed-style marker of a single glyph rendered with FreeType
+cv::Mat renderGlyphMarker(FT_Face face, uint32_t codepoint) {
+    int size = SYNTH_GLYPH_MARKER_SIZE;
+    cv::Mat marker(size, size, CV_8UC1, cv::Scalar(255));
+    cv::rectangle(marker, cv::Rect(0, 0, size, size), cv::Scalar(0), 3);
+    cv::rectangle(marker, cv::Rect(0, size - 18, 18, 18), cv::Scalar(0), -1);
+
+    if (FT_Load_Char(face, codepoint, FT_LOAD_RENDER)) {
+        throw std::invalid_argument("Font has no glyph for a requested kanji");
+    }
+    FT_Bitmap& bitmap = face->glyph->bitmap;
+    cv::Mat glyph((int)bitmap.rows, (int)bitmap.width, CV_8UC1, bitmap.buffer, bitmap.pitch);
+    cv::Rect target((size - glyph.cols) / 2, (size - glyph.rows) / 2, glyph.cols, glyph.rows);
+    target &= cv::Rect(0, 0, size, size);
+    cv::Mat region = marker(target);
+    region -= glyph(cv::Rect(0, 0, target.width, target.height));
+    return marker;
+}
+
+// Marker with white paper around, like a printed card
+cv::Mat makeCard(const cv::Mat& marker) {
+    int margin = (int)std::round(marker.cols * SYNTH_CARD_MARGIN);
+    cv::Mat card;
+    cv::copyMakeBorder(marker, card, margin, margin, margin, margin, cv::BORDER_CONSTANT, cv::Scalar(255));
+    return card;
+}
+
+std::vector<MarkerTemplate> loadTemplates(Json::Value meta, MetaManager& metaManager, std::string extraGlyphs) {
+    FT_Library library;
+    FT_Face face;
+    if (FT_Init_FreeType(&library) || FT_New_Face(library, FTGL_FONT_PATH, 0, &face)) {
+        throw std::invalid_argument("No such font file!");
+    }
+    FT_Set_Pixel_Sizes(face, 0, SYNTH_GLYPH_MARKER_SIZE * 6 / 10);
+
+    std::vector<MarkerTemplate> templates;
+    for (const Json::Value& monji : meta["monji"]) {
+        cv::Mat marker;
+        if (monji.isMember("marker")) {
+            marker = cv::imread("../" + monji["marker"].asString(), cv::IMREAD_GRAYSCALE);
+        }
+        if (marker.empty()) {
+            marker = renderGlyphMarker(face, decodeUtf8(monji["kanji"].asString())[0]);
+        }
+        templates.push_back({ monji["id"].asInt(), monji["kanji"].asString(), makeCard(marker) });
+    }
+
+    // Extra glyphs, -1 when the tracker can't know them
+    for (uint32_t codepoint : decodeUtf8(extraGlyphs)) {
+        std::string kanji = encodeUtf8(codepoint);
+        int id = metaManager.getIdByKanji(kanji);
+        templates.push_back({ id, kanji, makeCard(renderGlyphMarker(face, codepoint)) });
+    }
+
+    FT_Done_Face(face);
+    FT_Done_FreeType(library);
+    return templates;
+}
+
+// Pinhole projection, camera looks down -z with y up like the poses of estimateSquarePose
+cv::Point2f project(const cv::Matx33d& R, const cv::Vec3d& t, const cv::Vec3d& local, const CameraIntrinsics& camera) {
+    cv::Vec3d p = R * local + t;
+    return cv::Point2f((float)(camera.cx + camera.fx * p[0] / -p[2]),
+        (float)(camera.cy - camera.fy * p[1] / -p[2]));
+}
+
+int main(int argc, char** argv)
+{
+    SynthOptions options = parseSynthOptions(argc, argv);
+    if (!cv::utils::fs::createDirectories(options.output)) {
+        throw std::invalid_argument("Cannot create " + options.output);
+    }
+
+    std::ifstream metaJson(META_JSON_PATH, std::ifstream::binary);
+    Json::Value meta;
+    metaJson >> meta;
+    MetaManager metaManager = MetaManager(meta);
+
+    std::vector<MarkerTemplate> templates = loadTemplates(meta, metaManager, options.glyphs);
+    cv::Size frameSize(options.width, options.height);
+    CameraIntrinsics camera;
+    camera.width = options.width;
+    camera.height = options.height;
+    camera.fx = camera.fy = SYNTH_FOCAL_LENGTH * camera.sizeScale();
+    camera.cx = options.width / 2.0;
+    camera.cy = options.height / 2.0;
+    cv::RNG rng(options.seed);
+
+    Json::Value truth;
+    truth["width"] = options.width;
+    truth["height"] = options.height;
+    truth["focalLength"] = camera.fx;
+    truth["markerSize"] = SYNTH_MARKER_SIZE;
+    truth["seed"] = options.seed;
+    truth["frames"] = Json::Value(Json::arrayValue);
+
+    double half = SYNTH_MARKER_SIZE / 2;
+    double cardHalf = half * (1 + 2 * SYNTH_CARD_MARGIN);
+
+    for (int frameIndex = 0; frameIndex < options.frames; frameIndex++) {
+        // Dark table, the white cards stand out like in the demo setup
+        cv::Mat frame(frameSize, CV_8UC3, cv::Scalar::all(rng.uniform(30, 110)));
+        std::vector<cv::Rect> placed;
+
+        Json::Value frameTruth;
+        frameTruth["frame"] = frameIndex;
+        frameTruth["markers"] = Json::Value(Json::arrayValue);
+
+        for (int m = 0; m < options.markers; m++) {
+            const MarkerTemplate& marker = templates[rng.uniform(0, (int)templates.size())];
+
+            for (int attempt = 0; attempt < SYNTH_PLACEMENT_TRIES; attempt++) {
+                // Distance from the wanted size, position from a random pixel
+                double size = rng.uniform(options.minSize, options.maxSize);
+                double z = camera.fx * SYNTH_MARKER_SIZE / size;
+                cv::Point2d center(rng.uniform(0.0, (double)options.width), rng.uniform(0.0, (double)options.height));
+                cv::Vec3d t((center.x - camera.cx) * z / camera.fx,
+                    -(center.y - camera.cy) * z / camera.fy, -z);
+
+                // Spin around the normal, then tilt about a random axis in the marker plane
+                double spin = rng.uniform(0.0, 2 * M_PI);
+                double axisAngle = rng.uniform(0.0, 2 * M_PI);
+                double tilt = rng.uniform(0.0, options.maxTilt) * M_PI / 180.0;
+                cv::Matx33d spinR, tiltR;
+                cv::Rodrigues(cv::Vec3d(0, 0, spin), spinR);
+                cv::Rodrigues(cv::Vec3d(cos(axisAngle), sin(axisAngle), 0) * tilt, tiltR);
+                cv::Matx33d R = tiltR * spinR;
+
+                // Card and marker corners: top left, top right, bottom right, bottom left of the upright marker
+                cv::Vec3d localCard[4] = { { -cardHalf, cardHalf, 0 }, { cardHalf, cardHalf, 0 }, { cardHalf, -cardHalf, 0 }, { -cardHalf, -cardHalf, 0 } };
+                cv::Vec3d localMarker[4] = { { -half, half, 0 }, { half, half, 0 }, { half, -half, 0 }, { -half, -half, 0 } };
+                std::vector<cv::Point2f> cardCorners(4), markerCorners(4);
+                for (int i = 0; i < 4; i++) {
+                    cardCorners[i] = project(R, t, localCard[i], camera);
+                    markerCorners[i] = project(R, t, localMarker[i], camera);
+                }
+
+                cv::Rect bounds = cv::boundingRect(cardCorners);
+                bool inside = (bounds & cv::Rect(0, 0, options.width, options.height)) == bounds;
+                bool overlaps = false;
+                for (const cv::Rect& other : placed) {
+                    overlaps |= (bounds & other).area() > 0;
+                }
+                if (!inside || overlaps) {
+                    continue;
+                }
+                placed.push_back(bounds);
+
+                // Paste the card, only pixels inside the card are written
+                cv::Point2f source[4] = {
+                    cv::Point2f(0, 0), cv::Point2f((float)marker.card.cols, 0),
+                    cv::Point2f((float)marker.card.cols, (float)marker.card.rows), cv::Point2f(0, (float)marker.card.rows)
+                };
+                cv::Mat card;
+                cv::cvtColor(marker.card, card, cv::COLOR_GRAY2BGR);
+                cv::warpPerspective(card, frame, cv::getPerspectiveTransform(source, cardCorners.data()), frameSize,
+                    cv::INTER_LINEAR, cv::BORDER_TRANSPARENT);
+
+                Json::Value markerTruth;
+                markerTruth["id"] = marker.id;
+                markerTruth["kanji"] = marker.kanji;
+                for (const cv::Point2f& corner : markerCorners) {
+                    Json::Value point(Json::arrayValue);
+                    point.append(corner.x);
+                    point.append(corner.y);
+                    markerTruth["corners"].append(point);
+                }
+                for (int row = 0; row < 3; row++) {
+                    for (int col = 0; col < 3; col++) {
+                        markerTruth["pose"].append(R(row, col));
+                    }
+                    markerTruth["pose"].append(t[row]);
+                }
+                for (double v : { 0.0, 0.0, 0.0, 1.0 }) {
+                    markerTruth["pose"].append(v);
+                }
+                frameTruth["markers"].append(markerTruth);
+                break;
+            }
+        }
+
+        // Uneven lighting: linear gain over the frame
+        cv::Mat lit;
+        frame.convertTo(lit, CV_32FC3);
+        double gain = rng.uniform(0.6, 1.1), gainX = rng.uniform(-0.4, 0.4), gainY = rng.uniform(-0.4, 0.4);
+        for (int y = 0; y < lit.rows; y++) {
+            cv::Vec3f* row = lit.ptr<cv::Vec3f>(y);
+            for (int x = 0; x < lit.cols; x++) {
+                row[x] *= (float)(gain + gainX * ((double)x / lit.cols - 0.5) + gainY * ((double)y / lit.rows - 0.5));
+            }
+        }
+
+        // Motion blur along a random direction
+        if (options.blur >= 1) {
+            int length = rng.uniform(1, (int)options.blur + 1);
+            cv::Mat kernel = cv::Mat::zeros(length * 2 + 1, length * 2 + 1, CV_32F);
+            double angle = rng.uniform(0.0, M_PI);
+            cv::Point2d direction(cos(angle) * length, sin(angle) * length);
+            cv::Point2d middle(length, length);
+            cv::line(kernel, middle - direction, middle + direction, cv::Scalar(1), 1, cv::LINE_AA);
+            kernel /= cv::sum(kernel)[0];
+            cv::filter2D(lit, lit, -1, kernel);
+        }
+
+        // Sensor noise
+        if (options.noise > 0) {
+            cv::Mat noise(lit.size(), CV_32FC3);
+            rng.fill(noise, cv::RNG::NORMAL, 0, options.noise);
+            lit += noise;
+        }
+        lit.convertTo(frame, CV_8UC3);
+
+        std::ostringstream name;
+        name << options.output << "/frame_" << std::setw(6) << std::setfill('0') << frameIndex << ".png";
+        if (!cv::imwrite(name.str(), frame)) {
+            throw std::invalid_argument("Cannot write " + name.str());
+        }
+        truth["frames"].append(frameTruth);
+    }
+
+    std::ofstream out(options.output + "/truth.json");
+    if (!out.is_open()) {
+        throw std::invalid_argument("Cannot write " + options.output + "/truth.json");
+    }
+    Json::StreamWriterBuilder builder;
+    builder["emitUTF8"] = true;
+    out << Json::writeString(builder, truth);
+    saveCalibration(options.output + "/calibration.yml", camera);
+    std::cout << "[Synth] " << options.frames << " frames with up to " << options.markers << " markers written to " << options.output << std::endl;
+    return 0;
+}
@@ -0,0 +1,233 @@
+#pragma once
+
+// C / C++
+#include <map>
+#include <vector>
+#include <string>
+#include <utility>
+#include <chrono>
+
+// OpenGL
+#include <GL/glew.h>
+
+// FTGL
+#include <FTGL/ftgl.h>
+
+// GLM
+#include <glm/glm.hpp>
+
+#include "Model.h"
+#include "MetaManager.h"
+#include "SdfText.h"
+
+// Which text of a lexicon entry a label shows
+enum TextLabel {
+    LABEL_ONYOMI,
+    LABEL_KUNYOMI,
+    LABEL_TANGO
+};
+
+// Text geometry cached per lexicon entry, drawn through the RenderQueue like every model
+// FTGL backend: FTGL tessellates and extrudes the glyph outlines through immediate mode on every Render call,
+// here it renders each label once in feedback mode and the captured triangles become a mesh
+// SDF backend: one textured quad per glyph from a signed distance field atlas
+class TextMeshCache {
+    public:
+        // FTGL backend, meshes are drawn with the model shader program
+        TextMeshCache(FTFont* para_font, MetaManager& para_metaManager, GLuint para_program) :
+            font(para_font), metaManager(para_metaManager) {
+            program = para_program;
+            attributes = VertexAttributes::ofProgram(program);
+        }
+
+        // SDF backend, quads are drawn with the sdf shader program
+        TextMeshCache(SdfFont* para_sdfFont, MetaManager& para_metaManager, GLuint para_program) :
+            sdfFont(para_sdfFont), metaManager(para_metaManager) {
+            program = para_program;
+        }
+
+        // Mesh of a label, built on first use
+        ModelHandle get(int id, TextLabel label) {
+            auto key = std::make_pair(id, label);
+            auto it = meshes.find(key);
+            if (it != meshes.end()) {
+                return it->second;
+            }
+
+            auto start = std::chrono::steady_clock::now();
+            ModelHandle mesh = sdfFont ? sdfFont->buildLabel(getText(id, label), getColor(label))
+                : build(getText(id, label), getColor(label));
+            buildMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            for (const Mesh& m : mesh->meshes) {
+                indexCount += m.indexCount;
+            }
+
+            meshes[key] = mesh;
+            return mesh;
+        }
+
+        // Program the label meshes have to be drawn with
+        GLuint getProgram() {
+            return program;
+        }
+
+        // Every label the lexicon can show
+        std::vector<std::pair<int, TextLabel>> getAllLabels() {
+            std::vector<std::pair<int, TextLabel>> labels;
+            for (int id : metaManager.getMonjiIds()) {
+                labels.push_back(std::make_pair(id, LABEL_ONYOMI));
+                labels.push_back(std::make_pair(id, LABEL_KUNYOMI));
+            }
+            for (int id : metaManager.getTangoIds()) {
+                labels.push_back(std::make_pair(id, LABEL_TANGO));
+            }
+            return labels;
+        }
+
+        // Strings of all labels, the SDF atlas needs their glyphs
+        std::vector<std::string> getAllTexts() {
+            std::vector<std::string> texts;
+            for (auto const& label : getAllLabels()) {
+                texts.push_back(getText(label.first, label.second));
+            }
+            return texts;
+        }
+
+        // Time spent building meshes so far
+        double getBuildMs() {
+            return buildMs;
+        }
+
+        // Indices of all built meshes, i.e. vertices processed when every label is drawn once
+        size_t getIndexCount() {
+            return indexCount;
+        }
+
+        // Drop all meshes, must be called while the GL context is still alive
+        void clear() {
+            meshes.clear();
+        }
+
+    private:
+        FTFont* font = NULL;
+        SdfFont* sdfFont = NULL;
+        MetaManager& metaManager;
+        GLuint program;
+        VertexAttributes attributes;
+        std::map<std::pair<int, TextLabel>, ModelHandle> meshes;
+        double buildMs = 0;
+        size_t indexCount = 0;
+
+        std::string getText(int id, TextLabel label) {
+            switch (label) {
+                case LABEL_ONYOMI:
+                    return u8"音読み：" + metaManager.getOnyomiById(id);
+                case LABEL_KUNYOMI:
+                    return u8"訓読み：" + metaManager.getKunyomiById(id);
+                default:
+                    return metaManager.getTangoById(id);
+            }
+        }
+
+        glm::vec3 getColor(TextLabel label) {
+            if (label == LABEL_TANGO) {
+                return glm::vec3(0, 0.35, 0.6); // こんぺき -> https://irocore.com/konpeki/
+            }
+            return glm::vec3(0, 0.36, 0.08); // しんぺき -> https://irocore.com/shinpeki/
+        }
+
+        // Capture the triangles FTGL emits for a string
+        ModelHandle build(std::string text, glm::vec3 color) {
+            // Fit the text box into the clip volume so nothing gets clipped, with some margin
+            FTBBox bbox = font->BBox(text.c_str());
+            glm::vec3 lo((float)bbox.Lower().X(), (float)bbox.Lower().Y(), (float)bbox.Lower().Z());
+            glm::vec3 hi((float)bbox.Upper().X(), (float)bbox.Upper().Y(), (float)bbox.Upper().Z());
+            lo -= glm::vec3(1.f);
+            hi += glm::vec3(1.f);
+
+            GLint viewport[4];
+            glGetIntegerv(GL_VIEWPORT, viewport);
+
+            glUseProgram(0);
+            glPushAttrib(GL_ENABLE_BIT);
+            glDisable(GL_CULL_FACE);
+            glMatrixMode(GL_PROJECTION);
+            glPushMatrix();
+            glLoadIdentity();
+            glOrtho(lo.x, hi.x, lo.y, hi.y, -hi.z, -lo.z);
+            glMatrixMode(GL_MODELVIEW);
+            glPushMatrix();
+            glLoadIdentity();
+
+            // Feedback values are only returned when the buffer was big enough
+            std::vector<GLfloat> feedback(1 << 16);
+            GLint values = -1;
+            while (values < 0) {
+                glFeedbackBuffer((GLsizei)feedback.size(), GL_3D, feedback.data());
+                glRenderMode(GL_FEEDBACK);
+                font->Render(text.c_str());
+                values = glRenderMode(GL_RENDER);
+                if (values < 0) {
+                    feedback.resize(feedback.size() * 2);
+                }
+            }
+
+            glMatrixMode(GL_PROJECTION);
+            glPopMatrix();
+            glMatrixMode(GL_MODELVIEW);
+            glPopMatrix();
+            glPopAttrib();
+
+            // Window coordinates => back into font units, depth 0 is the near plane at hi.z
+            auto toFontSpace = [&](const GLfloat* v) {
+                return glm::vec3(lo.x + (v[0] - viewport[0]) / viewport[2] * (hi.x - lo.x),
+                    lo.y + (v[1] - viewport[1]) / viewport[3] * (hi.y - lo.y),
+                    hi.z - v[2] * (hi.z - lo.z));
+            };
+
+            MeshData data;
+            int i = 0;
+            while (i < values) {
+                GLint token = (GLint)feedback[i++];
+                if (token == GL_POLYGON_TOKEN) {
+                    int count = (int)feedback[i++];
+                    int first = (int)data.vertexPosition.size();
+                    for (int k = 0; k < count; k++) {
+                        data.vertexPosition.push_back(toFontSpace(&feedback[i + k * 3]));
+                        data.vertexTexcoord.push_back(glm::vec2(0.5f));
+                        data.vertexNormal.push_back(glm::vec3(0.f, 0.f, 1.f));
+                    }
+                    // Triangle fan over the polygon
+                    for (int k = 1; k + 1 < count; k++) {
+                        data.index.push_back(first);
+                        data.index.push_back(first + k);
+                        data.index.push_back(first + k + 1);
+                    }
+                    i += count * 3;
+                }
+                else if (token == GL_LINE_TOKEN || token == GL_LINE_RESET_TOKEN) {
+                    i += 6;
+                }
+                else if (token == GL_PASS_THROUGH_TOKEN) {
+                    i += 1;
+                }
+                else {
+                    // Point, bitmap and pixel tokens carry one vertex
+                    i += 3;
+                }
+            }
+
+            // Text is drawn with the model shader, a 1x1 texture carries the color
+            unsigned char rgb[3] = { (unsigned char)(color.r * 255), (unsigned char)(color.g * 255), (unsigned char)(color.b * 255) };
+            GLuint tex;
+            glGenTextures(1, &tex);
+            glBindTexture(GL_TEXTURE_2D, tex);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, rgb);
+
+            std::shared_ptr<Model> mesh = std::make_shared<Model>();
+            mesh->build(std::move(data), tex, attributes, "text " + text);
+            return mesh;
+        }
+};
@@ -1,38 +1,330 @@
 #include "Tracker.h"
 
+// C / C++
+#include <cstring>
+#include <algorithm>
+
+// Tesseract, per symbol results of the batched OCR
+#include <tesseract/resultiterator.h>
+
+// OpenCV universal intrinsics, SSE/NEON/VSX depending on the build
+#include <opencv2/core/hal/intrin.hpp>
+
+// Fixed point weights of cv::COLOR_BGR2GRAY, results match cvtColor
+#define GRAY_SHIFT 14
+#define GRAY_B 1868
+#define GRAY_G 9617
+#define GRAY_R 4899
+
+namespace {
+	// Row stripes of grayAndThreshold, a loop body object instead of a lambda so no std::function is allocated
+	class GrayThresholdBody : public cv::ParallelLoopBody {
+		public:
+			GrayThresholdBody(const cv::Mat& para_bgr, cv::Mat* para_gray, cv::Mat& para_binary, int para_threshold)
+				: bgr(para_bgr), gray(para_gray), binary(para_binary), threshold(para_threshold) {}
+
+			void operator()(const cv::Range& rows) const override {
+				for (int y = rows.start; y < rows.end; y++) {
+					const uchar* src = bgr.ptr<uchar>(y);
+					uchar* g = gray ? gray->ptr<uchar>(y) : NULL;
+					uchar* b = binary.ptr<uchar>(y);
+					int x = 0;
+#if CV_SIMD128
+					// Comparison masks are 0xFF / 0x00, exactly the THRESH_BINARY output; out of range thresholds go the scalar way
+					if (threshold >= 0 && threshold < 255) {
+						const v_uint16x8 wb = v_setall_u16(GRAY_B), wg = v_setall_u16(GRAY_G), wr = v_setall_u16(GRAY_R);
+						const v_uint32x4 round = v_setall_u32(1 << (GRAY_SHIFT - 1));
+						const v_uint8x16 limit = v_setall_u8((uchar)threshold);
+						for (; x <= bgr.cols - 16; x += 16) {
+							v_uint8x16 vb, vg, vr;
+							v_load_deinterleave(src + 3 * x, vb, vg, vr);
+							v_uint16x8 b16[2], g16[2], r16[2], y16[2];
+							v_expand(vb, b16[0], b16[1]);
+							v_expand(vg, g16[0], g16[1]);
+							v_expand(vr, r16[0], r16[1]);
+							for (int half = 0; half < 2; half++) {
+								v_uint32x4 lo, hi, lo2, hi2;
+								v_mul_expand(b16[half], wb, lo, hi);
+								v_mul_expand(g16[half], wg, lo2, hi2);
+								lo += lo2; hi += hi2;
+								v_mul_expand(r16[half], wr, lo2, hi2);
+								lo += lo2; hi += hi2;
+								y16[half] = v_pack((lo + round) >> GRAY_SHIFT, (hi + round) >> GRAY_SHIFT);
+							}
+							v_uint8x16 vy = v_pack(y16[0], y16[1]);
+							if (g) {
+								v_store(g + x, vy);
+							}
+							v_store(b + x, vy > limit);
+						}
+					}
+#endif
+					for (; x < bgr.cols; x++) {
+						int value = (src[3 * x] * GRAY_B + src[3 * x + 1] * GRAY_G + src[3 * x + 2] * GRAY_R + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT;
+						if (g) {
+							g[x] = (uchar)value;
+						}
+						b[x] = value > threshold ? 255 : 0;
+					}
+				}
+			}
+
+		private:
+			const cv::Mat& bgr;
+			cv::Mat* gray;
+			cv::Mat& binary;
+			int threshold;
+	};
+}
+
+void grayAndThreshold(const cv::Mat& bgr, cv::Mat* gray, cv::Mat& binary, int threshold) {
+	if (bgr.type() != CV_8UC3) {
+		throw std::invalid_argument("grayAndThreshold needs an 8 bit BGR frame.");
+	}
+	if (gray) {
+		gray->create(bgr.size(), CV_8UC1);
+	}
+	binary.create(bgr.size(), CV_8UC1);
+
+	// Rows are independent, stripes run on OpenCV's thread pool like cvtColor does
+	cv::parallel_for_(cv::Range(0, bgr.rows), GrayThresholdBody(bgr, gray, binary, threshold), std::max(1, bgr.rows / 32));
+}
+
+// cv::getPerspectiveTransform solves the same 8x8 system, but returns a newly allocated Mat
+static cv::Matx33d perspectiveTransform(const cv::Point2f src[4], const cv::Point2f dst[4]) {
+	cv::Matx<double, 8, 8> a;
+	cv::Matx<double, 8, 1> b;
+	for (int i = 0; i < 4; i++) {
+		a(i, 0) = a(i + 4, 3) = src[i].x;
+		a(i, 1) = a(i + 4, 4) = src[i].y;
+		a(i, 2) = a(i + 4, 5) = 1;
+		a(i, 3) = a(i, 4) = a(i, 5) = a(i + 4, 0) = a(i + 4, 1) = a(i + 4, 2) = 0;
+		a(i, 6) = -src[i].x * dst[i].x;
+		a(i, 7) = -src[i].y * dst[i].x;
+		a(i + 4, 6) = -src[i].x * dst[i].y;
+		a(i + 4, 7) = -src[i].y * dst[i].y;
+		b(i) = dst[i].x;
+		b(i + 4) = dst[i].y;
+	}
+	cv::Matx<double, 8, 1> h = a.solve(b, cv::DECOMP_LU);
+	return cv::Matx33d(h(0), h(1), h(2), h(3), h(4), h(5), h(6), h(7), 1);
+}
+
+tesseract::TessBaseAPI* initTesseract(std::string whitelist) {
+	tesseract::TessBaseAPI* api = new tesseract::TessBaseAPI();
+	// Set DATA_PATH to traindata path
+	if (api->Init(TESSERACT_DATA_PATH, "jpn", tesseract::OcrEngineMode::OEM_TESSERACT_ONLY)) {
+		throw std::invalid_argument("Fail to load jpn tesseract traindata.");
+	}
+
+	api->SetVariable("user_defined_dpi", "300");
+	// block numbers and some special characters
+	api->SetVariable("tessedit_char_blacklist", "0123456789!@#$%^&*()_+-=");
+	api->SetVariable("tessedit_char_whitelist", whitelist.c_str());
+	// set Page Segmentation mode to detect just for single char (kanji)
+	api->SetPageSegMode(tesseract::PSM_SINGLE_CHAR);
+
+	return api;
+}
+
 Tracker::Tracker(tesseract::TessBaseAPI* para_api, Json::Value para_objs) {
 	api = para_api;
 	objs = para_objs;
+	for (int i = 0; i < (int)objs.size(); i++) {
+		MarkerSlot slot;
+		slot.id = objs[i]["id"].asInt();
+		slot.kanji = objs[i]["kanji"].asString();
+		slot.corners.resize(4);
+		slot.pose.create(4, 4, CV_32F);
+		slots.push_back(slot);
+	}
 }
 
-cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
-	// Result Pose (RT)
-	float resultMatrix[16];
-	resultMatrix[0] = -1;
+void Tracker::setDebugWindows(bool enabled) {
+	debugWindows = enabled;
+}
+
+void Tracker::setTablePlane(bool enabled) {
+	tablePlane = enabled;
+}
 
-	// Clone frame for tracking
-	cv::Mat imgFiltered = frame.clone();
+void Tracker::setIntrinsics(const CameraIntrinsics& para_intrinsics) {
+	intrinsics = para_intrinsics;
+	camera = intrinsics;
+}
+
+void Tracker::setPyramidLevels(int levels) {
+	if (levels < 0) {
+		throw std::invalid_argument("Pyramid levels must not be negative.");
+	}
+	pyramidLevels = levels;
+}
+
+void Tracker::setQuadDetector(bool enabled) {
+	quadDetection = enabled;
+}
+
+void Tracker::setOcrCache(bool enabled) {
+	ocrCaching = enabled;
+	ocrCache.clear();
+}
 
-	// Convert to gray scale image
-	cv::Mat grayScale;
-	cv::cvtColor(imgFiltered, grayScale, cv::COLOR_BGR2GRAY);
+const OcrCacheStats& Tracker::getOcrCacheStats() {
+	return ocrCache.getStats();
+}
 
-	// Thresholding for distinct contrast
-	cv::threshold(grayScale, grayScale, threshold_value, 255, cv::THRESH_BINARY);
+void Tracker::setBatchedOcr(bool enabled) {
+	batchedOcr = enabled;
+}
 
-	// OpenCV function for finding contours inside BW-image
-	contour_vector_t contours;
-	cv::findContours(grayScale, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+// One plane for all markers of the frame, every marker pose is a closed form position and rotation on it
+// A single marker or a degenerate plane falls back to the independent solve
+void Tracker::estimateOnTable() {
+	tablePoses.resize(16 * tableSlots.size());
+	bool onTable = tableSlots.size() >= 2 && estimateTablePoses(tablePoses.data(), tableCorners.data(), (int)tableSlots.size(), 0.041, (float)camera.fx);
+	for (size_t m = 0; m < tableSlots.size(); m++) {
+		if (!onTable) {
+			estimateSquarePose(&tablePoses[16 * m], &tableCorners[4 * m], 0.041, (float)camera.fx);
+		}
+		storePose(slots[tableSlots[m]], &tablePoses[16 * m]);
+	}
+}
+
+void Tracker::storePose(MarkerSlot& slot, const float* pose) {
+	std::copy(pose, pose + 16, (float*)slot.pose.data);
+}
+
+void Tracker::erode3x3(const cv::Mat& src, cv::Mat& dst) {
+	dst.create(src.size(), CV_8UC1);
+	for (int y = 0; y < src.rows; y++) {
+		uchar* out = dst.ptr<uchar>(y);
+		for (int x = 0; x < src.cols; x++) {
+			// Outside pixels don't count, like the default border of cv::erode
+			uchar value = 255;
+			for (int v = std::max(0, y - 1); v <= std::min(src.rows - 1, y + 1); v++) {
+				const uchar* in = src.ptr<uchar>(v);
+				for (int u = std::max(0, x - 1); u <= std::min(src.cols - 1, x + 1); u++) {
+					value = std::min(value, in[u]);
+				}
+			}
+			out[x] = value;
+		}
+	}
+}
+
+void Tracker::fillFromCorners(cv::Mat& marker) {
+	const cv::Point seeds[4] = {
+		cv::Point(0, 0), cv::Point(0, marker.rows - 1), cv::Point(marker.cols - 1, 0), cv::Point(marker.cols - 1, marker.rows - 1)
+	};
+	const cv::Point neighbours[4] = { cv::Point(1, 0), cv::Point(-1, 0), cv::Point(0, 1), cv::Point(0, -1) };
+	for (const cv::Point& seed : seeds) {
+		uchar value = marker.at<uchar>(seed);
+		if (value == 255) {
+			continue;
+		}
+		// Pixels of the seed value connected to it become white
+		fillStack.clear();
+		fillStack.push_back(seed);
+		marker.at<uchar>(seed) = 255;
+		while (!fillStack.empty()) {
+			cv::Point p = fillStack.back();
+			fillStack.pop_back();
+			for (const cv::Point& step : neighbours) {
+				cv::Point q = p + step;
+				if (q.x >= 0 && q.y >= 0 && q.x < marker.cols && q.y < marker.rows && marker.at<uchar>(q) == value) {
+					marker.at<uchar>(q) = 255;
+					fillStack.push_back(q);
+				}
+			}
+		}
+	}
+}
+
+const TrackTimings& Tracker::getLastTimings() {
+	return timings;
+}
+
+cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
+	timings = TrackTimings();
+	tableSlots.clear();
+	tableCorners.clear();
+	ocrCandidates.clear();
+	currentStage = STAGE_PREPROCESS;
+	stageStart = std::chrono::steady_clock::now();
+
+	// Calibration of another resolution is scaled to the frame, once per frame size
+	if (camera.width != frame.cols || camera.height != frame.rows) {
+		camera = intrinsics.scaledTo(frame.cols, frame.rows);
+	}
+	double sizeScale = camera.sizeScale();
+
+	// Overlays are drawn into a copy of the frame, without debug windows nothing is drawn and nothing copied
+	cv::Mat imgFiltered = frame;
+	if (debugWindows) {
+		if (frame.channels() == 1) {
+			cv::cvtColor(frame, imgFiltered, cv::COLOR_GRAY2BGR);
+		}
+		else {
+			imgFiltered = frame.clone();
+		}
+	}
+	cv::Mat* overlay = debugWindows ? &imgFiltered : NULL;
+
+	// Gray scale and thresholding for distinct contrast in one pass
+	// A Y plane from the capture is the gray image already, only the threshold is left
+	cv::Mat gray = frame;
+	if (frame.channels() == 1) {
+		cv::threshold(frame, binaryImage, threshold_value, 255, cv::THRESH_BINARY);
+	}
+	else {
+		// Only the pyramid reads the gray image, without it the pass writes the binary image alone
+		grayAndThreshold(frame, pyramidLevels > 0 ? &grayImage : NULL, binaryImage, threshold_value);
+		gray = grayImage;
+	}
+	// Edge refinement and the marker warp sample the binary image
+	const cv::Mat& grayScale = binaryImage;
+
+	// Contours are searched on a downsampled level, corners are refined on the full resolution
+	cv::Mat detectImage = binaryImage;
+	if (pyramidLevels > 0) {
+		pyramidImages.resize(pyramidLevels + 1);
+		cv::Mat level = gray;
+		for (int l = 0; l < pyramidLevels; l++) {
+			cv::pyrDown(level, pyramidImages[l]);
+			level = pyramidImages[l];
+		}
+		cv::threshold(level, pyramidImages[pyramidLevels], threshold_value, 255, cv::THRESH_BINARY);
+		detectImage = pyramidImages[pyramidLevels];
+	}
+	int detectScale = 1 << pyramidLevels;
+
+	// Quads of dark borders in one scan, or OpenCV function for finding contours inside BW-image
+	enterStage(STAGE_CONTOURS);
+	const std::vector<quad_points_t>* quads = NULL;
+	if (quadDetection) {
+		quads = &quadDetector.detect(detectImage, (int)(MIN_MARKER_SIZE * sizeScale) / detectScale);
+	}
+	else {
+		cv::findContours(detectImage, contours, cv::RETR_LIST, cv::CHAIN_APPROX_SIMPLE);
+	}
+	size_t candidateCount = quads ? quads->size() : contours.size();
 
 	// For each found Contour
-	for (size_t k = 0; k < contours.size(); k++) {
+	for (size_t k = 0; k < candidateCount; k++) {
+		enterStage(STAGE_CONTOURS);
 
-		contour_t approx_contour;
+		contour_t& approx_contour = approxContour;
 
 		// Simplifying of the contour with the Ramer-Douglas-Peuker Algorithm
 		// true -> Only closed contours
 		// Approxicv::Mation of old curve, the difference (epsilon) should not be bigger than: perimeter(->arcLength)*0.02
-		cv::approxPolyDP(contours[k], approx_contour, arcLength(contours[k], true) * 0.02, true);
+		// The QuadDetector delivers quads already
+		if (quads) {
+			approx_contour.assign((*quads)[k].begin(), (*quads)[k].end());
+		}
+		else {
+			cv::approxPolyDP(contours[k], approx_contour, arcLength(contours[k], true) * 0.02, true);
+		}
 		
 		cv::Scalar colour;
 		// 4 Corners => We color them
@@ -44,17 +336,27 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 			continue;
 		}
 
+		// Back to full resolution coordinates
+		for (cv::Point& point : approx_contour) {
+			point *= detectScale;
+		}
+
 		// Convert to a usable rectangle
 		cv::Rect r = cv::boundingRect(approx_contour);
 		// Filter tiny ones, if the found contour is too small 
-		// (20 -> pixels, frame.cols - 10 to prevent extreme big contours)
-		if (r.height < 20 || r.width < 20 || r.width > imgFiltered.cols - 10 || r.height > imgFiltered.rows - 10) {
+		// (MIN_MARKER_SIZE -> pixels, frame.cols - MARKER_BORDER_MARGIN to prevent extreme big contours), both scale with the resolution
+		int minSize = (int)(MIN_MARKER_SIZE * sizeScale), margin = (int)(MARKER_BORDER_MARGIN * sizeScale);
+		if (r.height < minSize || r.width < minSize || r.width > frame.cols - margin || r.height > frame.rows - margin) {
 			continue;
 		}
+		timings.candidates++;
+		enterStage(STAGE_REFINE);
 
 		// Draw Founded potential markers in OpenCV
 		// 1 -> 1 contour, we have a closed contour, true -> closed, 4 -> thickness
-		cv::polylines(imgFiltered, approx_contour, true, colour, THICKNESS_VALUE);
+		if (overlay) {
+			cv::polylines(imgFiltered, approx_contour, true, colour, THICKNESS_VALUE);
+		}
 
 
 
@@ -66,7 +368,9 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 		// For each corner point
 		for (size_t i = 0; i < approx_contour.size(); ++i) {
 			// Render the corners, 3 -> Radius, -1 filled circle
-			cv::circle(imgFiltered, approx_contour[i], 3, CV_RGB(0, 255, 0), -1);
+			if (overlay) {
+				cv::circle(imgFiltered, approx_contour[i], 3, CV_RGB(0, 255, 0), -1);
+			}
 
 			// Euclidic distance, 7 -> parts, both directions dx and dy
 			// Direction between two corner points
@@ -89,124 +393,16 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 				cv::Point p;
 				p.x = (int)px;
 				p.y = (int)py;
-				cv::circle(imgFiltered, p, 2, CV_RGB(0, 0, 255), -1);
-
-				// Columns: Loop over 3 pixels
-				for (int m = -1; m <= 1; ++m) {
-					// Rows: From bottom to top of the stripe, e.g. -3 to 3
-					for (int n = strip.nStart; n <= strip.nStop; ++n) {
-						cv::Point2f subPixel;
-
-						// m -> going over the 3 pixel thickness of the stripe, n -> over the length of the stripe, direction comes from the orthogonal vector in st
-						// Going from bottom to top and defining the pixel coordinate for each pixel belonging to the stripe
-						subPixel.x = (double)p.x + ((double)m * strip.stripeVecX.x) + ((double)n * strip.stripeVecY.x);
-						subPixel.y = (double)p.y + ((double)m * strip.stripeVecX.y) + ((double)n * strip.stripeVecY.y);
-
-						cv::Point p2;
-						p2.x = (int)subPixel.x;
-						p2.y = (int)subPixel.y;
-
-						// The one (purple color) which is shown in the stripe window
-						//if (isFirstStripe)
-						//	circle(imgFiltered, p2, 1, CV_RGB(255, 0, 255), -1);
-						//else
-						cv::circle(imgFiltered, p2, 1, CV_RGB(0, 255, 255), -1);
-
-						// Combined Intensity of the subpixel
-						int pixelIntensity = subpixSampleSafe(grayScale, subPixel);
-
-						// Converte from index to pixel coordinate
-						// m (Column, real) -> -1,0,1 but we need to map to 0,1,2 -> add 1 to 0..2
-						int w = m + 1;
-
-						// n (Row, real) -> add stripeLenght >> 1 to shift to 0..stripeLength
-						// n=0 -> -length/2, n=length/2 -> 0 ........ + length/2
-						int h = n + (strip.stripeLength >> 1);
-
-						// Set pointer to correct position and safe subpixel intensity
-						imagePixelStripe.at<uchar>(h, w) = (uchar)pixelIntensity;
-					}
-				}
-
-				// Apply sobel operator on stripe
-
-				// ( -1 , -2, -1 )
-				// (  0 ,  0,  0 )
-				// (  1 ,  2,  1 )
-
-				// The first and last row must be excluded from the sobel calculation because they have no top or bottom neighbors
-				std::vector<double> sobelValues(strip.stripeLength - 2.);
-
-				// To use the kernel we start with the second row (n) and stop before the last one
-				for (int n = 1; n < (strip.stripeLength - 1); n++) {
-					// Take the intensity value from the stripe 
-					unsigned char* stripePtr = &(imagePixelStripe.at<uchar>(n - 1, 0));
-
-					// Calculation of the gradient with the sobel for the first row
-					double r1 = -stripePtr[0] - 2. * stripePtr[1] - stripePtr[2];
-
-					// Go two lines for the third line of the sobel, step = size of the data type, here uchar
-					stripePtr += 2 * imagePixelStripe.step;
-
-					// Calculation of the gradient with the sobel for the third row
-					double r3 = stripePtr[0] + 2. * stripePtr[1] + stripePtr[2];
-
-					// Writing the result into our sobel value vector
-					unsigned int ti = n - 1;
-					sobelValues[ti] = r1 + r3;
-				}
-
-				double maxIntensity = -1;
-				int maxIntensityIndex = 0;
-
-				// Finding the max value (where has the most sharp change)
-				for (int n = 0; n < strip.stripeLength - 2; ++n) {
-					if (sobelValues[n] > maxIntensity) {
-						maxIntensity = sobelValues[n];
-						maxIntensityIndex = n;
-					}
+				if (overlay) {
+					cv::circle(imgFiltered, p, 2, CV_RGB(0, 0, 255), -1);
 				}
 
-				// f(x) slide 7 -> y0 .. y1 .. y2
-				double y0, y1, y2;
-
-				// Point before and after
-				unsigned int max1 = maxIntensityIndex - 1, max2 = maxIntensityIndex + 1;
-
-				// If the index is at the border we are out of the stripe, then we will take 0
-				y0 = (maxIntensityIndex <= 0) ? 0 : sobelValues[max1];
-				y1 = sobelValues[maxIntensityIndex];
-				// If we are going out of the array of the sobel values
-				y2 = (maxIntensityIndex >= strip.stripeLength - 3) ? 0 : sobelValues[max2];
-
-				// Formula for calculating the x-coordinate of the vertex of a parabola, given 3 points with equal distances 
-				// (xv means the x value of the vertex, d the distance between the points): 
-				// xv = x1 + (d / 2) * (y2 - y0)/(2*y1 - y0 - y2)
-
-				// Equation system
-				// d = 1 because of the normalization and x1 will be added later
-				double pos = (y2 - y0) / (4 * y1 - 2 * y0 - 2 * y2);
-
-				// If the found pos is not a number -> there is no solution
-				if (isnan(pos)) {
+				// Subpixel edge position across the stripe
+				cv::Point2f edgeCenter;
+				if (!refineEdgePoint(grayScale, p, strip, imagePixelStripe, edgeCenter, overlay)) {
 					continue;
 				}
-
-				// Exact point with subpixel accuracy
-				cv::Point2d edgeCenter;
-
-				// Back to Index positioning, Where is the edge (max gradient) in the picture?
-				int maxIndexShift = maxIntensityIndex - (strip.stripeLength >> 1);
-
-				// Shift the original edgepoint accordingly -> Is the pixel point at the top or bottom?
-				edgeCenter.x = (double)p.x + (((double)maxIndexShift + pos) * strip.stripeVecY.x);
-				edgeCenter.y = (double)p.y + (((double)maxIndexShift + pos) * strip.stripeVecY.y);
-
-				// Highlight the subpixel with blue color
-				cv::circle(imgFiltered, edgeCenter, 2, CV_RGB(0, 0, 255), -1);
-
-				edgePointCenters[j - 1].x = edgeCenter.x;
-				edgePointCenters[j - 1].y = edgeCenter.y;
+				edgePointCenters[j - 1] = edgeCenter;
 
 				// Draw the stripe in the image
 				//if (isFirstStripe) {
@@ -242,13 +438,15 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 			p2.y = (int)lineParams[12 + i] + (int)(50.0 * lineParams[4 + i]);
 
 			// Draw line
-			cv::line(imgFiltered, p1, p2, CV_RGB(0, 255, 255), 3, 8, 0);
+			if (overlay) {
+				cv::line(imgFiltered, p1, p2, CV_RGB(0, 255, 255), 3, 8, 0);
+			}
 		}
 
 		// So far we stored the exact line parameters and show the lines in the image 
 		// Now we have to calculate the exact corners
 		cv::Point2f corners[4];
-		std::vector<cv::Point2f> copyCorners(4);
+		cv::Point2f copyCorners[4];
 
 		// Calculate the intersection points of both lines
 		for (int i = 0; i < 4; ++i) {
@@ -315,14 +513,19 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 			p.x = (int)corners[i].x;
 			p.y = (int)corners[i].y;
 
-			cv::circle(imgFiltered, p, 5, CV_RGB(255, 255, 0), -1);
+			if (overlay) {
+				cv::circle(imgFiltered, p, 5, CV_RGB(255, 255, 0), -1);
+			}
 		} // End of the loop to extract the exact corners
 
 		// Draw center of corners
 		cv::Point2f center = getCenterOfCorners(copyCorners);
-		cv::circle(imgFiltered, center, 5, CV_RGB(255, 0, 0), -1);
+		if (overlay) {
+			cv::circle(imgFiltered, center, 5, CV_RGB(255, 0, 0), -1);
+		}
 
 		// Coordinates on the original marker images to go to the actual center of the first pixel -> 100 * 100
+		enterStage(STAGE_NORMALIZE);
 		cv::Point2f targetCorners[4];
 		targetCorners[0].x = -0.5; targetCorners[0].y = -0.5;
 		targetCorners[1].x = 99.5; targetCorners[1].y = -0.5;
@@ -332,12 +535,11 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 		// Create and calculate the cv::Matrix of perspective transform -> non-affine -> parallel stays not parallel
 		// Homography is a cv::Matrix to describe the transforcv::Mation 
 		// From an image region to the 2D projected image
-		cv::Mat homographyMatrix(cv::Size(3, 3), CV_32FC1);
 		// Corner which we calculated and our target cv::Mat, find the transforcv::Mation
-		homographyMatrix = cv::getPerspectiveTransform(corners, targetCorners);
+		cv::Matx33d homographyMatrix = perspectiveTransform(corners, targetCorners);
 
-		// Create image for the marker
-		cv::Mat imageMarker(cv::Size(100, 100), CV_8UC1);
+		// Image for the marker, the buffer is kept by the tracker
+		cv::Mat& imageMarker = markerImage;
 
 		// Change the perspective in the marker image using the previously calculated Homography cv::Matrix
 		// In the Homography cv::Matrix there is also the position in the image saved
@@ -345,19 +547,11 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 
 		// Now we have a B/W image of a supposed Marker include Kanji
 		cv::threshold(imageMarker, imageMarker, 55, 255, cv::THRESH_BINARY);
-		// Use Erosion to expand the black glyph part, make the kanji solider
-		int dilation_size = 1;
-		cv::Mat element = getStructuringElement(cv::MORPH_RECT,
-			cv::Size(2 * dilation_size + 1, 2 * dilation_size + 1),
-			cv::Point(dilation_size, dilation_size));
-		cv::Mat erodedMarker;
-		cv::erode(imageMarker, erodedMarker, element);
+		// Use Erosion (3x3) to expand the black glyph part, make the kanji solider
+		erode3x3(imageMarker, erodedMarker);
 
 		// Flood fill in four corners to remove the border 
-		cv::floodFill(imageMarker, cv::Point(0, 0), cv::Scalar(255, 255, 255));
-		cv::floodFill(imageMarker, cv::Point(0, imageMarker.rows - 1), cv::Scalar(255, 255, 255));
-		cv::floodFill(imageMarker, cv::Point(imageMarker.cols - 1, 0), cv::Scalar(255, 255, 255));
-		cv::floodFill(imageMarker, cv::Point(imageMarker.cols - 1, imageMarker.rows - 1), cv::Scalar(255, 255, 255));
+		fillFromCorners(imageMarker);
 		float floodMean = mean(imageMarker)[0];
 		if (floodMean >= 240 || floodMean <= 128) {
 			continue;
@@ -371,7 +565,8 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 
 		// If mean > 128 (not that black) => need rotation
 		while (cv::mean(croppedArea)[0] > 128) {
-			cv::rotate(erodedMarker, erodedMarker, cv::ROTATE_90_CLOCKWISE);
+			cv::rotate(erodedMarker, rotatedMarker, cv::ROTATE_90_CLOCKWISE);
+			cv::swap(erodedMarker, rotatedMarker);
 			counter++;
 			croppedArea = erodedMarker(myROI);
 			if (counter >= 4) {
@@ -382,25 +577,52 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 			continue;
 		}
 
-		cv::imshow("ErodedMarker", erodedMarker);
-		cv::floodFill(erodedMarker, cv::Point(0, 0), cv::Scalar(255, 255, 255));
-		cv::floodFill(erodedMarker, cv::Point(0, erodedMarker.rows - 1), cv::Scalar(255, 255, 255));
-		cv::floodFill(erodedMarker, cv::Point(erodedMarker.cols - 1, 0), cv::Scalar(255, 255, 255));
-		cv::floodFill(erodedMarker, cv::Point(erodedMarker.cols - 1, erodedMarker.rows - 1), cv::Scalar(255, 255, 255));
+		if (debugWindows) {
+			cv::imshow("ErodedMarker", erodedMarker);
+		}
+		fillFromCorners(erodedMarker);
 
 		// Pass the eroded and floodfilled marker to Tesseract for Character Recognition
-		api->SetImage(mat8ToPix(&erodedMarker));
+		enterStage(STAGE_OCR);
+		int foundIdx = -1;
+		// The same marker seen before, e.g. put back on the table, skips Tesseract
+		OcrCache::Hash markerHash = {};
+		bool cached = false;
+		if (ocrCaching) {
+			markerHash = OcrCache::hash(erodedMarker);
+			cached = ocrCache.lookup(markerHash, foundIdx);
+		}
+		if (cached) {
+			timings.ocrCacheHits++;
+		}
 
-		// Get Detected Text from Tesseract API
-		std::string outText = std::string(api->GetUTF8Text());
+		// Recognized together with the other markers of the frame after the loop
+		if (batchedOcr) {
+			size_t n = ocrCandidates.size();
+			ocrCandidates.resize(n + 1);
+			OcrCandidate& candidate = ocrCandidates[n];
+			std::copy(copyCorners, copyCorners + 4, candidate.imageCorners);
+			std::copy(corners, corners + 4, candidate.corners);
+			candidate.rotation = counter;
+			candidate.hash = markerHash;
+			candidate.pending = !cached;
+			candidate.result = foundIdx;
+			if (candidate.pending) {
+				if (ocrCrops.size() <= n) {
+					ocrCrops.resize(n + 1);
+				}
+				erodedMarker.copyTo(ocrCrops[n]);
+			}
+			continue;
+		}
 
-		// Identifying which kanji is detected
-		int foundIdx = -1;
-		for (int i = 0; i < objs.size(); i++) {
-			if (outText.find(objs[i]["kanji"].asString()) == std::string::npos) {
-				continue;
+		if (!cached) {
+			auto recognitionStart = std::chrono::steady_clock::now();
+			foundIdx = recognizeMarker(erodedMarker);
+			if (ocrCaching) {
+				ocrCache.insert(markerHash, foundIdx,
+					std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - recognitionStart).count());
 			}
-			foundIdx = i;
 		}
 
 		// If no kanji detected also no need to continue the following steps
@@ -408,82 +630,372 @@ cv::Mat Tracker::track(cv::Mat frame, int threshold_value) {
 			continue;
 		} 
 
-		// Save the Corners for found Kanji
-		detectedMarkerCorners[objs[foundIdx]["id"].asInt()] = copyCorners;
-
-		// Correct the order of the corners, if 0 -> already have the 0 degree position
-		if (counter != 0) {
-			cv::Point2f corrected_corners[4];
-			// Smallest id represents the x-axis, we put the values in the corrected_corners array
-			for (int i = 0; i < 4; i++)	corrected_corners[(counter + i) % 4] = corners[i];
-			// We put the values back in the array in the sorted order
-			for (int i = 0; i < 4; i++)	corners[i] = corrected_corners[i];
-		}
-
-		// Transfer screen coords to camera coords -> To get to the principal point
-		for (int i = 0; i < 4; i++) {
-			// Here you have to use your own camera resolution (x) * 0.5
-			corners[i].x -= 320;
-			// -(corners.y) -> is needed because y is inverted
-			// Here you have to use your own camera resolution (y) * 0.5
-			corners[i].y = -corners[i].y + 240;
-		}
-
-		// 4x4 -> Rotation | Translation
-		//        0  0  0  | 1 -> (Homogene coordinates to combine rotation, translation and scaling)
-		// 0.041 => Marker size in meters!
-		estimateSquarePose(resultMatrix, (cv::Point2f*)corners, 0.041);
-
-		// Change float[] to cv::Mat
-		cv::Mat resPose = (cv::Mat_<float>(4, 4) << resultMatrix[0], resultMatrix[1], resultMatrix[2], resultMatrix[3],
-													resultMatrix[4], resultMatrix[5], resultMatrix[6], resultMatrix[7],
-													resultMatrix[8], resultMatrix[9], resultMatrix[10], resultMatrix[11],
-													resultMatrix[12], resultMatrix[13], resultMatrix[14], resultMatrix[15]);
-		
-		// Save found Pose for detected Kanji
-		detectedMarkers[objs[foundIdx]["id"].asInt()] = resPose;
+		enterStage(STAGE_POSE);
+		placeMarker(foundIdx, counter, copyCorners, corners);
+	}
+
+	if (batchedOcr && !ocrCandidates.empty()) {
+		enterStage(STAGE_OCR);
+		recognizeMosaic();
+		enterStage(STAGE_POSE);
+		for (OcrCandidate& candidate : ocrCandidates) {
+			if (candidate.result != -1) {
+				placeMarker(candidate.result, candidate.rotation, candidate.imageCorners, candidate.corners);
+			}
+		}
+	}
+
+	if (tablePlane && !tableSlots.empty()) {
+		enterStage(STAGE_POSE);
+		estimateOnTable();
 	}
 
 	//imshow("OpenCV", imgFiltered);
 	//isFirstStripe = true;
+	enterStage(STAGE_COUNT);
 	return imgFiltered;
 }
 
 
+int Tracker::matchKanji(const char* text) {
+	int found = -1;
+	for (int i = 0; text && i < (int)slots.size(); i++) {
+		if (std::strstr(text, slots[i].kanji.c_str()) != NULL) {
+			found = i;
+		}
+	}
+	return found;
+}
+
+int Tracker::recognizeMarker(cv::Mat& marker) {
+	timings.ocrCalls++;
+	timings.ocrMarkers++;
+	// Tesseract's own memory is not tracker scratch
+	AllocationCounter::Ignore ignore;
+	// Tesseract copies the image, the Pix and the text belong to us
+	Pix* pix = mat8ToPix(&marker);
+	api->SetImage(pix);
+
+	// Get Detected Text from Tesseract API
+	char* outText = api->GetUTF8Text();
+
+	// Identifying which kanji is detected
+	int found = matchKanji(outText);
+	delete[] outText;
+	pixDestroy(&pix);
+	return found;
+}
+
+void Tracker::recognizeMosaic() {
+	ocrCells.clear();
+	for (int i = 0; i < (int)ocrCandidates.size(); i++) {
+		if (ocrCandidates[i].pending) {
+			ocrCells.push_back(i);
+		}
+	}
+	int count = (int)ocrCells.size();
+	if (count == 0) {
+		return;
+	}
+	auto start = std::chrono::steady_clock::now();
+
+	// A single marker is recognized more reliably in the single character mode
+	if (count == 1) {
+		ocrCandidates[ocrCells[0]].result = recognizeMarker(ocrCrops[ocrCells[0]]);
+	}
+	else {
+		// Cells in rows of OCR_MOSAIC_COLUMNS, the mosaic buffer only grows
+		int columns = std::min(count, OCR_MOSAIC_COLUMNS);
+		int rows = (count + columns - 1) / columns;
+		int stride = 100 + OCR_MOSAIC_GAP;
+		cv::Size size(OCR_MOSAIC_GAP + columns * stride, OCR_MOSAIC_GAP + rows * stride);
+		if (ocrMosaic.cols < size.width || ocrMosaic.rows < size.height) {
+			ocrMosaic.create(std::max(ocrMosaic.rows, size.height), std::max(ocrMosaic.cols, size.width), CV_8UC1);
+		}
+		cv::Mat mosaic = ocrMosaic(cv::Rect(cv::Point(0, 0), size));
+		mosaic.setTo(255);
+		for (int c = 0; c < count; c++) {
+			cv::Rect cell(OCR_MOSAIC_GAP + (c % columns) * stride, OCR_MOSAIC_GAP + (c / columns) * stride, 100, 100);
+			ocrCrops[ocrCells[c]].copyTo(mosaic(cell));
+		}
+
+		timings.ocrCalls++;
+		AllocationCounter::Ignore ignore;
+		Pix* pix = mat8ToPix(&mosaic);
+		api->SetImage(pix);
+		// The kanjis are scattered over the page, the sparse mode finds each of them with its box
+		api->SetPageSegMode(tesseract::PSM_SPARSE_TEXT);
+		if (ocrCellText.size() < (size_t)count) {
+			ocrCellText.resize(count);
+		}
+		for (int c = 0; c < count; c++) {
+			ocrCellText[c].clear();
+		}
+		tesseract::ResultIterator* it = api->Recognize(NULL) == 0 ? api->GetIterator() : NULL;
+		bool recognized = it != NULL;
+		if (recognized) {
+			do {
+				char* symbol = it->GetUTF8Text(tesseract::RIL_SYMBOL);
+				int left, top, right, bottom;
+				if (symbol && it->BoundingBox(tesseract::RIL_SYMBOL, &left, &top, &right, &bottom)) {
+					// The cell around the center of the box, each gap is split between its two cells
+					int column = ((left + right) / 2 - OCR_MOSAIC_GAP / 2) / stride;
+					int row = ((top + bottom) / 2 - OCR_MOSAIC_GAP / 2) / stride;
+					int cell = row * columns + column;
+					if (column < columns && cell < count) {
+						ocrCellText[cell] += symbol;
+					}
+				}
+				delete[] symbol;
+			} while (it->Next(tesseract::RIL_SYMBOL));
+			delete it;
+			timings.ocrMarkers += count;
+		}
+		api->SetPageSegMode(tesseract::PSM_SINGLE_CHAR);
+		pixDestroy(&pix);
+
+		for (int c = 0; c < count; c++) {
+			// A kanji split into several symbols is matched as a whole; without a result every marker gets its own call
+			ocrCandidates[ocrCells[c]].result = recognized ? matchKanji(ocrCellText[c].c_str()) : recognizeMarker(ocrCrops[ocrCells[c]]);
+		}
+	}
+
+	// Every marker of the call is charged the same share of its time, only cells with a kanji are stored
+	if (ocrCaching) {
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / count;
+		for (int cell : ocrCells) {
+			ocrCache.insert(ocrCandidates[cell].hash, ocrCandidates[cell].result, ms);
+		}
+	}
+}
+
+void Tracker::placeMarker(int slotIndex, int rotation, const cv::Point2f* imageCorners, cv::Point2f* corners) {
+	// Save the Corners for found Kanji
+	MarkerSlot& slot = slots[slotIndex];
+	slot.detected = true;
+	std::copy(imageCorners, imageCorners + 4, slot.corners.begin());
+
+	// Correct the order of the corners, if 0 -> already have the 0 degree position
+	if (rotation != 0) {
+		cv::Point2f corrected_corners[4];
+		// Smallest id represents the x-axis, we put the values in the corrected_corners array
+		for (int i = 0; i < 4; i++)	corrected_corners[(rotation + i) % 4] = corners[i];
+		// We put the values back in the array in the sorted order
+		for (int i = 0; i < 4; i++)	corners[i] = corrected_corners[i];
+	}
+
+	// Lens distortion is removed from the four refined corners only, the frame stays distorted
+	camera.undistortPixels(corners, 4);
+
+	// Transfer screen coords to camera coords -> To get to the principal point
+	for (int i = 0; i < 4; i++) {
+		corners[i].x -= (float)camera.cx;
+		// -(corners.y) -> is needed because y is inverted
+		// The pose estimation knows one focal length, non-square pixels are stretched to fx
+		corners[i].y = (float)((camera.cy - corners[i].y) * camera.fx / camera.fy);
+	}
+
+	// All markers of the frame are solved together after the loop
+	if (tablePlane) {
+		tableSlots.push_back(slotIndex);
+		tableCorners.insert(tableCorners.end(), corners, corners + 4);
+		return;
+	}
+
+	// Result Pose (RT)
+	// 4x4 -> Rotation | Translation
+	//        0  0  0  | 1 -> (Homogene coordinates to combine rotation, translation and scaling)
+	// 0.041 => Marker size in meters!
+	float resultMatrix[16];
+	estimateSquarePose(resultMatrix, (cv::Point2f*)corners, 0.041, (float)camera.fx);
+
+	// Save found Pose for detected Kanji, float[] into the slot's cv::Mat
+	storePose(slot, resultMatrix);
+}
+
 std::map<int, std::vector<cv::Point2f>> Tracker::getDetectedMarkerCorners() {
-	return detectedMarkerCorners;
+	std::map<int, std::vector<cv::Point2f>> res;
+	for (const MarkerSlot& slot : slots) {
+		if (slot.detected) {
+			res[slot.id] = slot.corners;
+		}
+	}
+	return res;
 }
 
 void Tracker::cleanDetectedMarkers() {
-	detectedMarkers.clear();
-	detectedMarkerCorners.clear();
+	for (MarkerSlot& slot : slots) {
+		slot.detected = false;
+	}
 	//detectedMarkerRotated.clear();
 }
 
 std::map<int, cv::Point2f> Tracker::getDetectedMarkerCenter() {
 	std::map<int, cv::Point2f> res;
 
-	for (auto const& x : detectedMarkerCorners)
+	for (const MarkerSlot& slot : slots)
 	{
-		cv::Point2f calculatedCenter = getCenterOfCorners(x.second);
-		res[x.first] = calculatedCenter;
+		if (slot.detected) {
+			res[slot.id] = getCenterOfCorners(slot.corners.data());
+		}
 	}
 
 	return res;
 }
 
 std::map<int, cv::Mat> Tracker::getDetectedMarkerPose() {
-	return detectedMarkers;
+	std::map<int, cv::Mat> res;
+	for (const MarkerSlot& slot : slots) {
+		if (slot.detected) {
+			res[slot.id] = slot.pose.clone();
+		}
+	}
+	return res;
+}
+
+const Tracker::MarkerSlot& Tracker::detectedSlot(int id) {
+	for (const MarkerSlot& slot : slots) {
+		if (slot.id == id && slot.detected) {
+			return slot;
+		}
+	}
+	throw std::out_of_range("Marker " + std::to_string(id) + " not detected.");
 }
 
 cv::Mat Tracker::getMarkerPoseById(int id) {
-	return detectedMarkers.at(id);
+	return detectedSlot(id).pose.clone();
 }
 
 cv::Point2f Tracker::getMarkerCenterById(int id) {
-	return getCenterOfCorners(detectedMarkerCorners.at(id));
+	return getCenterOfCorners(detectedSlot(id).corners.data());
 }
 
 std::vector<cv::Point2f> Tracker::getMarkerCornersById(int id) {
-	return detectedMarkerCorners.at(id);
+	return detectedSlot(id).corners;
+}
+
+// Sample the stripe around p across the edge and locate the edge with subpixel accuracy (Sobel + parabola)
+// Returns false when the parabola has no vertex, the samples are drawn into debugImage when given
+bool Tracker::refineEdgePoint(const cv::Mat& gray, cv::Point p, const MyStrip& strip, cv::Mat& imagePixelStripe, cv::Point2f& edgePoint, cv::Mat* debugImage) {
+	// Columns: Loop over 3 pixels
+	for (int m = -1; m <= 1; ++m) {
+		// Rows: From bottom to top of the stripe, e.g. -3 to 3
+		for (int n = strip.nStart; n <= strip.nStop; ++n) {
+			cv::Point2f subPixel;
+
+			// m -> going over the 3 pixel thickness of the stripe, n -> over the length of the stripe, direction comes from the orthogonal vector in st
+			// Going from bottom to top and defining the pixel coordinate for each pixel belonging to the stripe
+			subPixel.x = (double)p.x + ((double)m * strip.stripeVecX.x) + ((double)n * strip.stripeVecY.x);
+			subPixel.y = (double)p.y + ((double)m * strip.stripeVecX.y) + ((double)n * strip.stripeVecY.y);
+
+			cv::Point p2;
+			p2.x = (int)subPixel.x;
+			p2.y = (int)subPixel.y;
+
+			// The one (purple color) which is shown in the stripe window
+			//if (isFirstStripe)
+			//	circle(imgFiltered, p2, 1, CV_RGB(255, 0, 255), -1);
+			//else
+			if (debugImage) {
+				cv::circle(*debugImage, p2, 1, CV_RGB(0, 255, 255), -1);
+			}
+
+			// Combined Intensity of the subpixel
+			int pixelIntensity = subpixSampleSafe(gray, subPixel);
+
+			// Converte from index to pixel coordinate
+			// m (Column, real) -> -1,0,1 but we need to map to 0,1,2 -> add 1 to 0..2
+			int w = m + 1;
+
+			// n (Row, real) -> add stripeLenght >> 1 to shift to 0..stripeLength
+			// n=0 -> -length/2, n=length/2 -> 0 ........ + length/2
+			int h = n + (strip.stripeLength >> 1);
+
+			// Set pointer to correct position and safe subpixel intensity
+			imagePixelStripe.at<uchar>(h, w) = (uchar)pixelIntensity;
+		}
+	}
+
+	// Apply sobel operator on stripe
+
+	// ( -1 , -2, -1 )
+	// (  0 ,  0,  0 )
+	// (  1 ,  2,  1 )
+
+	// The first and last row must be excluded from the sobel calculation because they have no top or bottom neighbors
+	sobelValues.resize(strip.stripeLength - 2);
+
+	// To use the kernel we start with the second row (n) and stop before the last one
+	for (int n = 1; n < (strip.stripeLength - 1); n++) {
+		// Take the intensity value from the stripe 
+		unsigned char* stripePtr = &(imagePixelStripe.at<uchar>(n - 1, 0));
+
+		// Calculation of the gradient with the sobel for the first row
+		double r1 = -stripePtr[0] - 2. * stripePtr[1] - stripePtr[2];
+
+		// Go two lines for the third line of the sobel, step = size of the data type, here uchar
+		stripePtr += 2 * imagePixelStripe.step;
+
+		// Calculation of the gradient with the sobel for the third row
+		double r3 = stripePtr[0] + 2. * stripePtr[1] + stripePtr[2];
+
+		// Writing the result into our sobel value vector
+		unsigned int ti = n - 1;
+		sobelValues[ti] = r1 + r3;
+	}
+
+	double maxIntensity = -1;
+	int maxIntensityIndex = 0;
+
+	// Finding the max value (where has the most sharp change)
+	for (int n = 0; n < strip.stripeLength - 2; ++n) {
+		if (sobelValues[n] > maxIntensity) {
+			maxIntensity = sobelValues[n];
+			maxIntensityIndex = n;
+		}
+	}
+
+	// f(x) slide 7 -> y0 .. y1 .. y2
+	double y0, y1, y2;
+
+	// Point before and after
+	unsigned int max1 = maxIntensityIndex - 1, max2 = maxIntensityIndex + 1;
+
+	// If the index is at the border we are out of the stripe, then we will take 0
+	y0 = (maxIntensityIndex <= 0) ? 0 : sobelValues[max1];
+	y1 = sobelValues[maxIntensityIndex];
+	// If we are going out of the array of the sobel values
+	y2 = (maxIntensityIndex >= strip.stripeLength - 3) ? 0 : sobelValues[max2];
+
+	// Formula for calculating the x-coordinate of the vertex of a parabola, given 3 points with equal distances 
+	// (xv means the x value of the vertex, d the distance between the points): 
+	// xv = x1 + (d / 2) * (y2 - y0)/(2*y1 - y0 - y2)
+
+	// Equation system
+	// d = 1 because of the normalization and x1 will be added later
+	double pos = (y2 - y0) / (4 * y1 - 2 * y0 - 2 * y2);
+
+	// If the found pos is not a number -> there is no solution
+	if (isnan(pos)) {
+		return false;
+	}
+
+	// Exact point with subpixel accuracy
+	cv::Point2d edgeCenter;
+
+	// Back to Index positioning, Where is the edge (max gradient) in the picture?
+	int maxIndexShift = maxIntensityIndex - (strip.stripeLength >> 1);
+
+	// Shift the original edgepoint accordingly -> Is the pixel point at the top or bottom?
+	edgeCenter.x = (double)p.x + (((double)maxIndexShift + pos) * strip.stripeVecY.x);
+	edgeCenter.y = (double)p.y + (((double)maxIndexShift + pos) * strip.stripeVecY.y);
+
+	// Highlight the subpixel with blue color
+	if (debugImage) {
+		cv::circle(*debugImage, edgeCenter, 2, CV_RGB(0, 0, 255), -1);
+	}
+
+	edgePoint.x = edgeCenter.x;
+	edgePoint.y = edgeCenter.y;
+	return true;
 }
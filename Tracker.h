@@ -1,6 +1,9 @@
 #pragma once
 
 #include <iostream>
+#include <chrono>
+#include <string>
+#include <stdexcept>
 
 // Tesseract
 #include <tesseract/baseapi.h>
@@ -10,16 +13,27 @@
 #include <json/json.h>
 
 #include "PoseEstimation.h"
+#include "Calibration.h"
+#include "QuadDetector.h"
+#include "Profiler.h"
+#include "AllocationCounter.h"
+#include "OcrCache.h"
 
 
+#define TESSERACT_DATA_PATH "../jpn_tess"
+
 #define DRAW_CONTOUR 0
 #define DRAW_RECTANGLE 0
 
 #define THICKNESS_VALUE 4
 
-typedef std::vector<cv::Point> contour_t;
-// List of contours
-typedef std::vector<contour_t> contour_vector_t;
+// Candidate size filter in pixels at 640 px frame width, scaled with the resolution
+#define MIN_MARKER_SIZE 20
+#define MARKER_BORDER_MARGIN 10
+
+// Batched OCR: marker images per mosaic row and white pixels around each, wider than a gap inside a kanji
+#define OCR_MOSAIC_COLUMNS 8
+#define OCR_MOSAIC_GAP 40
 
 struct MyStrip {
     int stripeLength;
@@ -29,11 +43,62 @@ struct MyStrip {
     cv::Point2f stripeVecY;
 };
 
+// Stages of Tracker::track, every part of a call is charged to one of them
+enum TrackStage {
+    STAGE_PREPROCESS,   // Gray scale and threshold
+    STAGE_CONTOURS,     // Contours, polygon approximation and size filter
+    STAGE_REFINE,       // Subpixel edges, line fitting and corner intersection
+    STAGE_NORMALIZE,    // Marker warp, erosion, flood fill and rotation check
+    STAGE_OCR,          // Tesseract recognition
+    STAGE_POSE,         // Square pose estimation
+    STAGE_COUNT
+};
+
+static const char* const TRACK_STAGE_NAMES[STAGE_COUNT] = {
+    "preprocess", "contours", "refine", "normalize", "ocr", "pose"
+};
+
+// Time per stage and work done in the last track call
+struct TrackTimings {
+    double ms[STAGE_COUNT] = {};
+    int candidates = 0;     // Quads which passed the size filter
+    int ocrCalls = 0;       // Tesseract recognitions
+    int ocrMarkers = 0;     // Marker images they recognized, several per call with batched OCR
+    int ocrCacheHits = 0;   // Recognitions taken from the OcrCache instead
+};
+
+// Tesseract set up for single kanjis, only the whitelisted characters are recognized
+// One instance per thread, the API is not thread safe
+tesseract::TessBaseAPI* initTesseract(std::string whitelist);
+
+// BGR to gray (the weights of cv::COLOR_BGR2GRAY) and THRESH_BINARY in one vectorized pass over the frame
+// gray (skipped when NULL) and binary are only reallocated when the frame size changes
+void grayAndThreshold(const cv::Mat& bgr, cv::Mat* gray, cv::Mat& binary, int threshold);
+
 class Tracker {
     public:
         Tracker(tesseract::TessBaseAPI* api, Json::Value objs);
+        // frame is BGR or the 8 bit luminance (e.g. the Y plane of the capture)
+        // Returns a BGR copy of the frame with the debug overlays, or the frame itself when the debug windows are off
         cv::Mat track(cv::Mat frame, int threshold_value);
-
+        // Show intermediate images and draw overlays, off for headless runs
+        void setDebugWindows(bool enabled);
+        // All markers lie on one table: the plane is estimated jointly, per marker only position and rotation on it
+        void setTablePlane(bool enabled);
+        // Camera of the frames, the default is the 640x480 laptop camera
+        void setIntrinsics(const CameraIntrinsics& intrinsics);
+        // Search contours on the n-th pyramid level (half size per level), corners are still refined on the full frame
+        void setPyramidLevels(int levels);
+        // Candidates from the run-length QuadDetector (default) or from findContours + approxPolyDP
+        void setQuadDetector(bool enabled);
+        // Reuse the recognition of near-identical marker images (see OcrCache), on by default
+        void setOcrCache(bool enabled);
+        const OcrCacheStats& getOcrCacheStats();
+        // Recognize all marker images of a frame in one Tesseract call on a mosaic instead of one call each
+        void setBatchedOcr(bool enabled);
+        const TrackTimings& getLastTimings();
+
+        // The maps and Mats are copies, they stay valid while the tracker goes on
         std::map<int, std::vector<cv::Point2f>> getDetectedMarkerCorners();
         std::map<int, cv::Point2f>  getDetectedMarkerCenter();
         std::map<int, cv::Mat> getDetectedMarkerPose();
@@ -43,18 +108,107 @@ class Tracker {
         std::vector<cv::Point2f> getMarkerCornersById(int id);
 
     private:
-        std::map<int, cv::Scalar> detectedMarkerRotated;
-        std::map<int, cv::Mat> detectedMarkers;
-        std::map<int, std::vector<cv::Point2f>> detectedMarkerCorners;
+        // Result storage of one lexicon entry, allocated once and overwritten by every frame that detects it
+        struct MarkerSlot {
+            int id;
+            std::string kanji;
+            bool detected = false;
+            std::vector<cv::Point2f> corners;   // 4, image pixels
+            cv::Mat pose;                       // 4x4 CV_32F, row major
+        };
+        std::vector<MarkerSlot> slots;          // In the order of objs
+        const MarkerSlot& detectedSlot(int id);
 
         const int threshold_slider_max = 255;
         int threshold_slider = 0;
         const int fps = 30;
         tesseract::TessBaseAPI* api;
         Json::Value objs;
+        bool debugWindows = true;
+        bool tablePlane = false;
+        CameraIntrinsics intrinsics;
+        CameraIntrinsics camera;    // intrinsics at the size of the current frame
+        int pyramidLevels = 0;
+        bool quadDetection = true;
+        QuadDetector quadDetector;
+        bool ocrCaching = true;
+        OcrCache ocrCache;
+        bool batchedOcr = false;
+
+        // Marker of the current frame waiting for the batched OCR
+        struct OcrCandidate {
+            cv::Point2f imageCorners[4];    // Stored with the marker
+            cv::Point2f corners[4];         // Refined, not rotated yet
+            int rotation;
+            OcrCache::Hash hash;
+            bool pending;                   // Not in the OcrCache, its image is in ocrCrops
+            int result;                     // Slot index, -1 without kanji
+        };
+        std::vector<OcrCandidate> ocrCandidates;
+        std::vector<cv::Mat> ocrCrops;      // Same index as ocrCandidates
+        std::vector<int> ocrCells;          // Candidate of each mosaic cell
+        std::vector<std::string> ocrCellText;   // Symbols found in each mosaic cell
+        cv::Mat ocrMosaic;
+
+        // Slot index of the last kanji found in the text, -1 for none
+        int matchKanji(const char* text);
+        // One Tesseract call in single character mode
+        int recognizeMarker(cv::Mat& marker);
+        // Results of all pending ocrCandidates, one Tesseract call for all of them
+        void recognizeMosaic();
+        // Store corners and pose of a recognized marker, corners are rotated and moved to camera coordinates
+        void placeMarker(int slotIndex, int rotation, const cv::Point2f* imageCorners, cv::Point2f* corners);
+
+        // Scratch memory, reused from frame to frame: once every buffer has seen the largest frame, candidate
+        // and marker, tracking allocates nothing (see AllocationCounter)
+        cv::Mat grayImage;
+        cv::Mat binaryImage;
+        std::vector<cv::Mat> pyramidImages;
+        contour_vector_t contours;
+        contour_t approxContour;
+        std::vector<uchar> stripeBuffer;
+        std::vector<double> sobelValues;
+        cv::Mat markerImage;
+        cv::Mat erodedMarker;
+        cv::Mat rotatedMarker;
+        std::vector<cv::Point> fillStack;
+
+        // Recognized markers of the current frame waiting for the table solve, 4 camera centered corners each
+        std::vector<int> tableSlots;
+        std::vector<cv::Point2f> tableCorners;
+        std::vector<float> tablePoses;
+        void estimateOnTable();
+        // Copy a row major pose into the slot's preallocated Mat
+        void storePose(MarkerSlot& slot, const float* pose);
+        // cv::erode with a 3x3 rectangle, without creating a filter engine per call
+        static void erode3x3(const cv::Mat& src, cv::Mat& dst);
+        // cv::floodFill to white (4-connected) from the four corners, with a reused stack
+        void fillFromCorners(cv::Mat& marker);
+
+        TrackTimings timings;
+        int currentStage = STAGE_PREPROCESS;
+        std::chrono::steady_clock::time_point stageStart;
+
+        // Charge the time since the last switch to the current stage and continue with another one
+        // Consecutive parts of one stage (e.g. rejected contours) form a single span in the profile
+        void enterStage(int stage) {
+            if (stage == currentStage) {
+                return;
+            }
+            auto now = std::chrono::steady_clock::now();
+            timings.ms[currentStage] += std::chrono::duration<double, std::milli>(now - stageStart).count();
+            PROFILE_RECORD(TRACK_STAGE_NAMES[currentStage], stageStart, now);
+            stageStart = now;
+            currentStage = stage;
+        }
+
+        // Kernels are timed on their own by the microbenchmark
+        friend class TrackerBench;
+
+        bool refineEdgePoint(const cv::Mat& gray, cv::Point p, const MyStrip& strip, cv::Mat& imagePixelStripe, cv::Point2f& edgePoint, cv::Mat* debugImage);
 
         // Get Center Point of 4 Corners
-        cv::Point2f getCenterOfCorners(std::vector<cv::Point2f> corners) {
+        cv::Point2f getCenterOfCorners(const cv::Point2f* corners) {
             return (corners[0] + corners[1] + corners[2] + corners[3]) / 4.0;
         }
 
@@ -84,6 +238,7 @@ class Tracker {
             return a + ((py * (b - a)) >> 8);
         }
 
+        // The returned Mat uses stripeBuffer, it is valid until the next call
         cv::Mat calculate_Stripe(double dx, double dy, MyStrip& st) {
             // Norm (euclidean distance) from the direction vector is the length (derived from the Pythagoras Theorem)
             double diffLength = sqrt(dx * dx + dy * dy);
@@ -117,7 +272,10 @@ class Tracker {
             st.stripeVecY.y = -st.stripeVecX.x;
 
             // 8 bit unsigned char with 1 channel, gray
-            return cv::Mat(stripeSize, CV_8UC1);
+            if (stripeBuffer.size() < (size_t)(stripeSize.width * stripeSize.height)) {
+                stripeBuffer.resize(stripeSize.width * stripeSize.height);
+            }
+            return cv::Mat(stripeSize, CV_8UC1, stripeBuffer.data());
         }
 
         // Transfer Mat* to Pix* for Tesseract recognition
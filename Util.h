@@ -26,22 +26,103 @@
 #include <json/json.h>
 
 #include "PoseEstimation.h"
+#include "Camera.h"
 
 #define VERTEX_SHADER_PATH "../shader/vshader.vert"
 #define FRAGMENT_SHADER_PATH "../shader/fshader.frag"
-#define META_JSON_PATH "../meta.json"
-#define TESSERACT_DATA_PATH "../jpn_tess"
 #define FTGL_FONT_PATH "../font/MSMINCHO.TTF"
-
+#define SDF_VERTEX_SHADER_PATH "../shader/sdf.vert"
+#define SDF_FRAGMENT_SHADER_PATH "../shader/sdf.frag"
+#define BACKGROUND_VERTEX_SHADER_PATH "../shader/background.vert"
+#define BACKGROUND_FRAGMENT_SHADER_PATH "../shader/background.frag"
+#define BACKGROUND_YUV_FRAGMENT_SHADER_PATH "../shader/background_yuv.frag"
+
+// Window width, the height follows the aspect ratio of the frames
+// Frames have the size of the calibration (640x480 without one)
 #define WINDOW_HEIGHT 480
 #define WINDOW_WIDTH 640
 
 #define DRAW_ALL_LINES 1
 
+// Print resource statistics every n frames
+#define STATS_REPORT_INTERVAL 300
+// Failed grabs in a row after which a camera counts as lost
+#define MAX_DROPPED_FRAMES 30
+
+// Labels from a signed distance field glyph atlas (1) or extruded by FTGL (0)
+#define TEXT_BACKEND_SDF 1
+// Compare both text backends at startup, drawing every label n times
+#define TEXT_BENCHMARK 0
+#define TEXT_BENCHMARK_FRAMES 100
+
+// OpenGL 3.3 core profile, FTGL renders through the fixed-function pipeline and needs the compatibility profile
+#define USE_CORE_PROFILE (TEXT_BACKEND_SDF && !TEXT_BENCHMARK)
+
+// Offscreen EGL rendering for --headless, set by the ARKANJI_HEADLESS CMake option
+#ifndef ARKANJI_HEADLESS
+#define ARKANJI_HEADLESS 0
+#endif
+
 /* PI */
 #ifndef M_PI
 #define M_PI 3.1415926535897932384626433832795
 #endif
+// Command line options
+struct Options {
+    std::string input = "0";        // Camera index, video file, image pattern or image directory
+    std::string output = "";        // Directory for the composited frames
+    std::string detections = "";    // JSON lines file with the detections of every frame
+    std::string trace = "";         // Chrome trace of the stage timers, needs ARKANJI_PROFILE
+    std::string metrics = "";       // Prometheus text file, rewritten while running
+    bool headless = false;          // No windows, render offscreen
+    bool table = false;             // All markers lie on one plane, see Tracker::setTablePlane
+    bool yuv = false;               // NV12 frames: Y plane to the tracker, color conversion in the background shader
+    std::string calibration = "";   // Camera intrinsics and frame size, OpenCV calibration file
+    int pyramidLevels = 0;          // Contour search on a downsampled level, e.g. 1 for 1280x720, 2 for 1920x1080
+    int threshold = 100;            // B/W-Threshold, the slider value when windows are shown
+    int maxFrames = -1;             // Stop after n frames, -1 runs until the input ends
+};
+
+/* parseOptions
+* ARKanji [--input <camera|video|pattern|dir>] [--output <dir>] [--detections <file.jsonl>]
+*         [--headless] [--threshold <0-255>] [--frames <n>] [--trace <file.json>]
+*         [--metrics <file.prom>] [--table] [--calibration <file.yml>] [--pyramid <levels>] [--yuv]
+*/
+Options parseOptions(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        auto value = [&]() {
+            if (i + 1 >= argc) {
+                throw std::invalid_argument("Missing value for " + arg);
+            }
+            return std::string(argv[++i]);
+        };
+        if (arg == "--input") options.input = value();
+        else if (arg == "--output") options.output = value();
+        else if (arg == "--detections") options.detections = value();
+        else if (arg == "--headless") options.headless = true;
+        else if (arg == "--table") options.table = true;
+        else if (arg == "--yuv") options.yuv = true;
+        else if (arg == "--calibration") options.calibration = value();
+        else if (arg == "--pyramid") options.pyramidLevels = std::stoi(value());
+        else if (arg == "--threshold") options.threshold = std::stoi(value());
+        else if (arg == "--frames") options.maxFrames = std::stoi(value());
+        else if (arg == "--trace") options.trace = value();
+        else if (arg == "--metrics") options.metrics = value();
+        else throw std::invalid_argument("Unknown option " + arg);
+    }
+    return options;
+}
+
+// Read the current framebuffer back as a BGR image, rows top down like OpenCV
+cv::Mat readFramebuffer(int width, int height) {
+    cv::Mat image(height, width, CV_8UC3);
+    glReadPixels(0, 0, width, height, GL_BGR, GL_UNSIGNED_BYTE, image.data);
+    cv::flip(image, image, 0);
+    return image;
+}
+
 // Read File text
 std::string readFile(std::string filepath)
 {
@@ -111,24 +192,6 @@ GLuint getShaderProgram(std::string fshader, std::string vshader)
     return shaderProgram;
 }
 
-// Init Tesseract API for Character Recognition
-tesseract::TessBaseAPI* initTesseract(std::string whitelist) {
-    tesseract::TessBaseAPI* api = new tesseract::TessBaseAPI();
-    // Set DATA_PATH to traindata path
-    if (api->Init(TESSERACT_DATA_PATH, "jpn", tesseract::OcrEngineMode::OEM_TESSERACT_ONLY)) {
-        throw std::invalid_argument("Fail to load jpn tesseract traindata.");
-    }
-
-    api->SetVariable("user_defined_dpi", "300");
-    // block numbers and some special characters
-    api->SetVariable("tessedit_char_blacklist", "0123456789!@#$%^&*()_+-=");
-    api->SetVariable("tessedit_char_whitelist", whitelist.c_str());
-    // set Page Segmentation mode to detect just for single char (kanji)
-    api->SetPageSegMode(tesseract::PSM_SINGLE_CHAR);
-
-    return api;
-}
-
 // Callback from slider control
 static void on_trackbar(int pos, void* slider_value) {
     *(static_cast<int*>(slider_value)) = pos;
@@ -136,43 +199,27 @@ static void on_trackbar(int pos, void* slider_value) {
 
 // Init OpenGL Rendering Pipleline
 void initGL() {
-    // Use fixed 
-    glUseProgram(0);
-
-    // For texturing the OpenCV WebCam feed as background in OpenGL
+    // For glReadPixels of the framebuffer
     glPixelStorei(GL_PACK_ALIGNMENT, 1);
-    // For glTexImage2D​ -> Define the texture image representation
+    // For glTexImage2D​ -> OpenCV rows are tightly packed
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    // Turn the texture coordinates from OpenCV to the texture coordinates OpenGL
-    glPixelZoom(1.0, -1.0);
 
-    // Enable and set colors
-    glEnable(GL_COLOR_MATERIAL);
     glClearColor(0, 0, 0, 1.0);
 
     // Enable and set depth parameters
     glEnable(GL_DEPTH_TEST);
     glClearDepth(1.0);
+
+    // Antialiased glyph edges of the SDF text are blended
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 }
 
-void setUpFrustum(GLFWwindow* window, int width, int height) {
+// Framebuffer size callback, the projection comes from the camera intrinsics
+// and is stretched with the background, so only the viewport follows the window
+void setUpViewport(GLFWwindow* window, int width, int height) {
     // Set a whole-window viewport
     glViewport(0, 0, (GLsizei)width, (GLsizei)height);
-
-    glMatrixMode(GL_PROJECTION);
-    glLoadIdentity();
-
-    float ratio = (GLfloat)width / (GLfloat)height;
-    float near = 0.01f, far = 100.f;
-
-    // The camera should be calibrated -> a calibration results in the projection matrix -> then load the matrix
-    // -> into GL_PROJECTION
-    // -> adjustment of FOV 45 is needed for each camera
-    float top = tan((double)(45.0 * M_PI / 360.0f)) * near;
-    float bottom = -top;
-    float left = ratio * bottom;
-    float right = ratio * top;
-    glFrustum(left, right, bottom, top, near, far);
 }
 
 // Init FTGL font for rendering Japanese words in 3D Context
@@ -191,31 +238,4 @@ FTFont* initFTGL() {
     return font;
 }
 
-/* getVirtualPose
-* Calculate the RT-Pose for a virtual marker
-* Virtual means it should not exist in real world
-* @param corners : vector of 4 corners points 
-* @return RT-Pose of the virtualMarker
-*/
-cv::Mat getVirtualPose(std::vector<cv::Point2f> corners) {
-    cv::Point2f targetCorners[4];
-    targetCorners[0].x = -0.5; targetCorners[0].y = -0.5;
-    targetCorners[1].x = 99.5; targetCorners[1].y = -0.5;
-    targetCorners[2].x = 99.5; targetCorners[2].y = 99.5;
-    targetCorners[3].x = -0.5; targetCorners[3].y = 99.5;
-    cv::Mat homographyMatrix(cv::Size(3, 3), CV_32FC1);
-    homographyMatrix = cv::getPerspectiveTransform(corners.data(), targetCorners);
-    for (int i = 0; i < 4; i++) {
-        corners[i].x -= (WINDOW_WIDTH / 2);
-        corners[i].y = -corners[i].y + (WINDOW_WIDTH / 2);
-    }
-    float resultMatrix[16];
-    estimateSquarePose(resultMatrix, corners.data(), 0.041);
-    cv::Mat resPose = (cv::Mat_<float>(4, 4) << resultMatrix[0], resultMatrix[1], resultMatrix[2], resultMatrix[3],
-        resultMatrix[4], resultMatrix[5], resultMatrix[6], resultMatrix[7],
-        resultMatrix[8], resultMatrix[9], resultMatrix[10], resultMatrix[11],
-        resultMatrix[12], resultMatrix[13], resultMatrix[14], resultMatrix[15]);
-
-    return resPose;
-}
 
@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec2 texcoord;    // Frame Coordinates
+
+out vec4 fColor;    // Fragment color
+
+uniform sampler2D frame;    // Camera frame
+
+void main()
+{
+    fColor = vec4(texture(frame, texcoord).rgb, 1.0);
+}
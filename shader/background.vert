@@ -0,0 +1,13 @@
+#version 330 core
+
+layout (location = 0) in vec2 vPosition;
+layout (location = 1) in vec2 vTexcoord;
+
+out vec2 texcoord;
+
+
+void main()
+{
+    gl_Position = vec4(vPosition, 0.0, 1.0); // Already NDC Coordinates
+    texcoord = vTexcoord;   // Frame Coordinates to frag
+}
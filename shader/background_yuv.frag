@@ -0,0 +1,17 @@
+#version 330 core
+
+in vec2 texcoord;    // Frame Coordinates
+
+out vec4 fColor;    // Fragment color
+
+uniform sampler2D yPlane;   // Luminance, full resolution
+uniform sampler2D uvPlane;  // Interleaved U/V, half resolution
+
+// BT.601 limited range like OpenCV's COLOR_YUV2BGR_NV12
+void main()
+{
+    float y = (texture(yPlane, texcoord).r - 16.0 / 255.0) * 1.164;
+    vec2 uv = texture(uvPlane, texcoord).rg - vec2(0.5);
+    vec3 rgb = vec3(y + 1.596 * uv.y, y - 0.392 * uv.x - 0.813 * uv.y, y + 2.017 * uv.x);
+    fColor = vec4(clamp(rgb, 0.0, 1.0), 1.0);
+}
@@ -4,9 +4,10 @@ in vec2 texcoord;    // Texture Coordinates
 
 out vec4 fColor;    // Fragment color
 
-uniform sampler2D texture;  
+uniform sampler2D diffuseTexture;
 
 void main()
 {
-    fColor.rgb =  texture2D(texture, texcoord).rgb;
+    fColor.rgb =  texture(diffuseTexture, texcoord).rgb;
+    fColor.a = 1.0;     // Opaque, blending is enabled for text
 }
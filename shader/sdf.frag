@@ -0,0 +1,19 @@
+#version 330 core
+
+in vec2 texcoord;    // Atlas Coordinates
+in vec3 color;       // Text color
+
+out vec4 fColor;    // Fragment color
+
+uniform sampler2D glyphAtlas;   // Signed distance field atlas, 0.5 is on the outline
+
+void main()
+{
+    float dist = texture(glyphAtlas, texcoord).r;
+    // Antialias over one screen pixel, stays sharp at any distance
+    float width = fwidth(dist);
+    float alpha = smoothstep(0.5 - width, 0.5 + width, dist);
+    if (alpha < 0.01)
+        discard;
+    fColor = vec4(color, alpha);
+}
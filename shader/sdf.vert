@@ -0,0 +1,23 @@
+#version 330 core
+
+layout (location = 0) in vec3 vPosition;
+layout (location = 1) in vec2 vTexcoord;
+layout (location = 2) in vec3 vColor;
+
+out vec2 texcoord;
+out vec3 color;
+
+uniform mat4 Model;       // Model placement in camera space
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
+
+
+void main()
+{
+    gl_Position = projection * view * Model * vec4(vPosition, 1.0); // NDC Coordinates
+    texcoord = vTexcoord;   // Atlas Coordinates to frag
+    color = vColor;
+}
@@ -6,11 +6,16 @@ layout (location = 2) in vec3 vNormal;
 
 out vec2 texcoord;
 
-uniform mat4 MVP;         // Model View Projection
+uniform mat4 Model;       // Model placement in camera space
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+};
 
 
 void main()
 {
-    gl_Position = MVP * vec4(vPosition, 1.0); // NDC Coordinates
+    gl_Position = projection * view * Model * vec4(vPosition, 1.0); // NDC Coordinates
     texcoord = vTexcoord;   // UV Coordinates to frag
 }